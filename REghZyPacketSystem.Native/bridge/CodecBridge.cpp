@@ -0,0 +1,45 @@
+// The exported C ABI of FrameCodec (see CodecBridge.h). This is built as its own shared library, which the
+// managed NativeFraming loads as "REghZyPacketCodec". It only needs a C++ compiler, not asio:
+//     g++ -O2 -std=c++17 -shared -fPIC -fvisibility=hidden CodecBridge.cpp -o libREghZyPacketCodec.so
+//     cl /O2 /LD /EHsc CodecBridge.cpp /Fe:REghZyPacketCodec.dll
+
+#include <new>
+#include "FrameCodec.h"
+
+struct rz_codec {
+    FrameCodec codec;
+
+    rz_codec(const rz_codec_config& config) : codec(config) { }
+};
+
+rz_codec* rz_codec_create(const rz_codec_config* config) {
+    if (config == nullptr || !FrameCodec::isValid(*config)) {
+        return nullptr;
+    }
+
+    return new(std::nothrow) rz_codec(*config);
+}
+
+void rz_codec_destroy(rz_codec* codec) {
+    delete(codec);
+}
+
+int32_t rz_codec_decode(rz_codec* codec, const uint8_t* buffer, uint32_t length, rz_frame* frames, uint32_t maxFrames, uint32_t* consumed) {
+    if (codec == nullptr || (buffer == nullptr && length != 0) || (frames == nullptr && maxFrames != 0) || consumed == nullptr) {
+        return RZ_CODEC_INVALID_ARG;
+    }
+
+    return codec->codec.decode(buffer, length, frames, maxFrames, *consumed);
+}
+
+int32_t rz_codec_encode(rz_codec* codec, const uint8_t* src, const rz_frame* frames, uint32_t count, uint8_t* dst, uint32_t dstLength) {
+    if (codec == nullptr || (count != 0 && (src == nullptr || frames == nullptr || dst == nullptr))) {
+        return RZ_CODEC_INVALID_ARG;
+    }
+
+    return codec->codec.encode(src, frames, count, dst, dstLength);
+}
+
+uint64_t rz_codec_get_skipped(rz_codec* codec) {
+    return codec == nullptr ? 0 : codec->codec.getSkipped();
+}
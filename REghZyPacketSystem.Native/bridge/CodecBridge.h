@@ -0,0 +1,69 @@
+#ifndef __IMPL_CODECBRIDGE
+#define __IMPL_CODECBRIDGE
+
+// The C ABI of the native frame codec, for use from other languages (e.g. the managed
+// PacketSystem, through P/Invoke). See FrameCodec.h for how frames are found and built
+//
+// Every function works on a whole batch, so a caller crosses into native code once per
+// receive buffer or send batch, rather than once per frame or per header field
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define RZ_CODEC_API __declspec(dllexport)
+#else
+#define RZ_CODEC_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The wire format to decode and encode. Header fields are big endian unless littleEndian is set
+typedef struct rz_codec_config {
+    uint8_t preamble[4];  // The bytes every frame starts with
+    uint8_t preambleLen;  // How many of the preamble bytes are used (0 - 4). With 0, a corrupted frame can't be recovered from
+    uint8_t idWidth;      // 1 (native packets) or 2 (managed packets)
+    uint8_t littleEndian; // Non-zero for little endian ID and length fields
+    uint8_t reserved;
+    uint32_t maxPayload;  // Frames with a longer payload are treated as corrupted
+} rz_codec_config;
+
+// A single frame. When decoding, offset is where the payload starts in the receive buffer. When
+// encoding, offset is where the payload is in the source buffer
+typedef struct rz_frame {
+    uint16_t id;
+    uint16_t reserved;
+    uint32_t offset;
+    uint32_t length;
+} rz_frame;
+
+enum RZ_CODEC_ERRCODE {
+    RZ_CODEC_INVALID_ARG = -1,  // A null pointer, or an unsupported config
+    RZ_CODEC_FRAME_SIZE  = -2,  // A payload is longer than maxPayload (and there is no preamble to resync with)
+    RZ_CODEC_BUFFER_FULL = -3   // The destination buffer is too small for the batch
+};
+
+typedef struct rz_codec rz_codec;
+
+// Creates a codec for the given wire format, or returns null if the config is invalid
+RZ_CODEC_API rz_codec* rz_codec_create(const rz_codec_config* config);
+
+RZ_CODEC_API void rz_codec_destroy(rz_codec* codec);
+
+// Finds up to maxFrames complete frames in the buffer. Returns the number found (or a negative RZ_CODEC_ERRCODE),
+// and sets consumed to how many bytes were used up; the rest (a partial frame) should be kept for the next call
+RZ_CODEC_API int32_t rz_codec_decode(rz_codec* codec, const uint8_t* buffer, uint32_t length, rz_frame* frames, uint32_t maxFrames, uint32_t* consumed);
+
+// Writes a header and the payload for each frame into dst, back to back. Returns
+// the number of bytes written, or a negative RZ_CODEC_ERRCODE (nothing is written then)
+RZ_CODEC_API int32_t rz_codec_encode(rz_codec* codec, const uint8_t* src, const rz_frame* frames, uint32_t count, uint8_t* dst, uint32_t dstLength);
+
+// The total number of bytes skipped while looking for a preamble, since the codec was created
+RZ_CODEC_API uint64_t rz_codec_get_skipped(rz_codec* codec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !__IMPL_CODECBRIDGE
@@ -0,0 +1,171 @@
+#ifndef __IMPL_FRAMECODEC
+#define __IMPL_FRAMECODEC
+
+#include <cstdint>
+#include <cstring>
+#include "CodecBridge.h"
+
+// Finds and builds whole frames in memory, without creating any packets. This is what the C ABI in
+// CodecBridge.h exposes, but it can be used directly too. It has no dependency on asio, so the
+// bridge library can be built on its own
+//
+// [ Preamble ] [  ID  ] [ Length ] [ Payload ]
+// [  0 - 4b  ] [ 1/2b ] [   2b   ] [ Len-b   ]
+//
+// Decoding only accepts a complete preamble. If the bytes don't match (corruption, or a
+// preamble that lost bytes on the wire), it skips forward a byte at a time until they do
+class FrameCodec {
+public:
+    FrameCodec(const rz_codec_config& config) {
+        m_config = config;
+        m_headerLen = config.preambleLen + config.idWidth + 2;
+        m_skipped = 0;
+    }
+
+public:
+    // The layout of the native Packet.h frames
+    static rz_codec_config nativeConfig() {
+        rz_codec_config config;
+        config.preamble[0] = 'r';
+        config.preamble[1] = 'z';
+        config.preamble[2] = '2';
+        config.preamble[3] = '1';
+        config.preambleLen = 4;
+        config.idWidth = 1;
+        config.littleEndian = 0;
+        config.reserved = 0;
+        config.maxPayload = 1017; // MAX_PAYLOAD_LEN
+        return config;
+    }
+
+    static bool isValid(const rz_codec_config& config) {
+        return config.preambleLen <= 4 && (config.idWidth == 1 || config.idWidth == 2) && config.maxPayload <= 0xFFFF;
+    }
+
+    int32_t decode(const uint8_t* buffer, uint32_t length, rz_frame* frames, uint32_t maxFrames, uint32_t& consumed) {
+        const uint8_t* preamble = m_config.preamble;
+        const uint32_t preambleLen = m_config.preambleLen;
+        uint32_t pos = 0;
+        uint32_t count = 0;
+        while (count < maxFrames) {
+            uint32_t remaining = length - pos;
+            if (preambleLen != 0) {
+                uint32_t match = 0;
+                while (match < preambleLen && match < remaining && buffer[pos + match] == preamble[match]) {
+                    match++;
+                }
+
+                if (match < preambleLen) {
+                    if (match == remaining) {
+                        break; // the buffer ends part way through what may be a preamble
+                    }
+
+                    // jump straight to the next byte that could start a preamble
+                    const void* next = memchr(buffer + pos + 1, preamble[0], remaining - 1);
+                    uint32_t skip = next ? (uint32_t)((const uint8_t*)next - (buffer + pos)) : remaining;
+                    m_skipped += skip;
+                    pos += skip;
+                    continue;
+                }
+            }
+
+            if (remaining < m_headerLen) {
+                break;
+            }
+
+            const uint8_t* header = buffer + pos + preambleLen;
+            uint16_t id = m_config.idWidth == 1 ? header[0] : readU16(header);
+            uint32_t payloadLen = readU16(header + m_config.idWidth);
+            if (payloadLen > m_config.maxPayload) {
+                if (preambleLen == 0) {
+                    consumed = pos;
+                    return count != 0 ? (int32_t)count : RZ_CODEC_FRAME_SIZE;
+                }
+
+                m_skipped++;
+                pos++;
+                continue;
+            }
+
+            if ((remaining - m_headerLen) < payloadLen) {
+                break;
+            }
+
+            rz_frame& frame = frames[count++];
+            frame.id = id;
+            frame.reserved = 0;
+            frame.offset = pos + m_headerLen;
+            frame.length = payloadLen;
+            pos += m_headerLen + payloadLen;
+        }
+
+        consumed = pos;
+        return (int32_t)count;
+    }
+
+    int32_t encode(const uint8_t* src, const rz_frame* frames, uint32_t count, uint8_t* dst, uint32_t dstLength) {
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (frames[i].length > m_config.maxPayload || (m_config.idWidth == 1 && frames[i].id > 0xFF)) {
+                return RZ_CODEC_FRAME_SIZE;
+            }
+
+            total += m_headerLen + frames[i].length;
+        }
+
+        if (total > dstLength || total > INT32_MAX) {
+            return RZ_CODEC_BUFFER_FULL;
+        }
+
+        uint8_t* out = dst;
+        for (uint32_t i = 0; i < count; i++) {
+            const rz_frame& frame = frames[i];
+            memcpy(out, m_config.preamble, m_config.preambleLen);
+            out += m_config.preambleLen;
+            if (m_config.idWidth == 1) {
+                *out++ = (uint8_t)frame.id;
+            }
+            else {
+                writeU16(out, frame.id);
+                out += 2;
+            }
+
+            writeU16(out, (uint16_t)frame.length);
+            out += 2;
+            memcpy(out, src + frame.offset, frame.length);
+            out += frame.length;
+        }
+
+        return (int32_t)total;
+    }
+
+    uint64_t getSkipped() {
+        return m_skipped;
+    }
+
+    const rz_codec_config& getConfig() {
+        return m_config;
+    }
+
+private:
+    uint16_t readU16(const uint8_t* p) {
+        return m_config.littleEndian ? (uint16_t)(p[0] | (p[1] << 8)) : (uint16_t)((p[0] << 8) | p[1]);
+    }
+
+    void writeU16(uint8_t* p, uint16_t v) {
+        if (m_config.littleEndian) {
+            p[0] = (uint8_t)v;
+            p[1] = (uint8_t)(v >> 8);
+        }
+        else {
+            p[0] = (uint8_t)(v >> 8);
+            p[1] = (uint8_t)v;
+        }
+    }
+
+    rz_codec_config m_config;
+    uint32_t m_headerLen;
+    uint64_t m_skipped;
+};
+
+#endif // !__IMPL_FRAMECODEC
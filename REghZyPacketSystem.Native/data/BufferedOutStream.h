@@ -18,37 +18,50 @@ public:
         m_windex = 0;
     }
 
+    // Doesn't flush; anything still buffered is discarded
+    ~BufferedOutStream() {
+        delete[] m_buffer;
+    }
+
+    BufferedOutStream(const BufferedOutStream&) = delete;
+    BufferedOutStream& operator=(const BufferedOutStream&) = delete;
+
     void write(uint8_t* ptr, uintptr_t offset, uint16_t count) override {
         if (count >= m_bufsize) {
+            flushBuffer();
             m_out->write(ptr, offset, count);
             return;
         }
 
         uintptr_t next = m_windex + count;
         if (next < m_windex) { // overflow detection
-            flush();
+            flushBuffer();
         }
         else if (next > m_bufsize) {
-            flush();
+            flushBuffer();
         }
 
         memcpy(m_buffer + m_windex, ptr + offset, count);
         m_windex += count;
     }
 
-    void write(uint8_t* ptr, uintptr_t offset, uint16_t count, asio::error_code err) {
+    void write(uint8_t* ptr, uintptr_t offset, uint16_t count, asio::error_code& err) override {
         if (count >= m_bufsize) {
-            flush(err);
+            flushBuffer(err);
+            if (err) {
+                return;
+            }
+
             m_out->write(ptr, offset, count, err);
             return;
         }
 
         uintptr_t next = m_windex + count;
-        if (next < m_windex) { // overflow detection
-            flush(err);
-        }
-        else if (next > m_bufsize) {
-            flush(err);
+        if (next < m_windex || next > m_bufsize) { // overflow detection
+            flushBuffer(err);
+            if (err) {
+                return;
+            }
         }
 
         memcpy(m_buffer + m_windex, ptr + offset, count);
@@ -56,13 +69,12 @@ public:
     }
 
     void flush() override {
-        m_out->write(m_buffer, 0, m_bufsize);
+        flushBuffer();
         m_out->flush();
-        m_windex = 0;
     }
 
     void flush(asio::error_code& err) override {
-        m_out->write(m_buffer, 0, m_bufsize, err);
+        flushBuffer(err);
         if (!err) {
             m_out->flush(err);
         }
@@ -84,6 +96,21 @@ public:
     }
 
 private:
+    // Writes only the buffered bytes to the underlying stream, without flushing it
+    void flushBuffer() {
+        if (m_windex) {
+            m_out->write(m_buffer, 0, (uint16_t)m_windex);
+            m_windex = 0;
+        }
+    }
+
+    void flushBuffer(asio::error_code& err) {
+        if (m_windex) {
+            m_out->write(m_buffer, 0, (uint16_t)m_windex, err);
+            m_windex = 0;
+        }
+    }
+
     OutputStream* m_out;
     uint8_t* m_buffer;
     uintptr_t m_windex;
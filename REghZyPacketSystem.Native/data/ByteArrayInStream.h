@@ -0,0 +1,78 @@
+#ifndef __IMPL_BYTEARRAYINSTREAM
+#define __IMPL_BYTEARRAYINSTREAM
+
+#include "InputStream.h"
+#include <cstring>
+
+// An input stream that reads from an in-memory byte array, without copying or owning it. Useful for
+// decoding packets out of a buffer that was received all at once (e.g. a datagram, or a container packet)
+//
+// Running out of data is an error (asio::error::eof). A caller that may only have part of a packet
+// can remember getPosition, and rewind with setPosition to retry once more data arrives
+class ByteArrayInStream : public InputStream {
+public:
+    ByteArrayInStream() {
+        m_buffer = nullptr;
+        m_size = 0;
+        m_pos = 0;
+    }
+
+    ByteArrayInStream(const uint8_t* buffer, size_t size) {
+        m_buffer = buffer;
+        m_size = size;
+        m_pos = 0;
+    }
+
+public:
+    uint16_t read(uint8_t* ptr, uintptr_t ptr_offset, uint16_t count) override {
+        asio::error_code err;
+        uint16_t read = this->read(ptr, ptr_offset, count, err);
+        if (err) {
+            throw asio::system_error(err);
+        }
+
+        return read;
+    }
+
+    uint16_t read(uint8_t* ptr, uintptr_t ptr_offset, uint16_t count, asio::error_code& err) override {
+        size_t remaining = m_size - m_pos;
+        if (remaining == 0 && count != 0) {
+            err = asio::error::eof;
+            return 0;
+        }
+
+        if (count > remaining) {
+            count = (uint16_t)remaining;
+        }
+
+        memcpy(ptr + ptr_offset, m_buffer + m_pos, count);
+        m_pos += count;
+        return count;
+    }
+
+    // Points this stream at a new buffer, and rewinds it
+    void reset(const uint8_t* buffer, size_t size) {
+        m_buffer = buffer;
+        m_size = size;
+        m_pos = 0;
+    }
+
+    size_t getPosition() {
+        return m_pos;
+    }
+
+    void setPosition(size_t pos) {
+        m_pos = pos > m_size ? m_size : pos;
+    }
+
+    size_t getRemaining() {
+        return m_size - m_pos;
+    }
+
+private:
+    const uint8_t* m_buffer;
+    size_t m_size;
+    size_t m_pos;
+};
+
+#endif // !__IMPL_BYTEARRAYINSTREAM
@@ -0,0 +1,57 @@
+#ifndef __IMPL_BYTEARRAYOUTSTREAM
+#define __IMPL_BYTEARRAYOUTSTREAM
+
+#include "OutputStream.h"
+#include <cstring>
+#include <vector>
+
+// An output stream that writes into a growable in-memory byte array. Useful for
+// encoding a packet before it gets sent (e.g. to queue it, or to measure it)
+class ByteArrayOutStream : public OutputStream {
+public:
+    ByteArrayOutStream() { }
+
+    ByteArrayOutStream(size_t capacity) {
+        m_buffer.reserve(capacity);
+    }
+
+    void write(uint8_t* ptr, uintptr_t offset, uint16_t count) override {
+        m_buffer.insert(m_buffer.end(), ptr + offset, ptr + offset + count);
+    }
+
+    void write(uint8_t* ptr, uintptr_t offset, uint16_t count, asio::error_code& err) override {
+        m_buffer.insert(m_buffer.end(), ptr + offset, ptr + offset + count);
+    }
+
+    // Clears the written bytes, but keeps the allocated capacity
+    void reset() {
+        m_buffer.clear();
+    }
+
+    // Discards everything written after the first size bytes
+    void truncate(size_t size) {
+        if (size < m_buffer.size()) {
+            m_buffer.resize(size);
+        }
+    }
+
+    uint8_t* getBuffer() {
+        return m_buffer.data();
+    }
+
+    size_t size() {
+        return m_buffer.size();
+    }
+
+    // Moves the written bytes out of this stream, leaving it empty
+    std::vector<uint8_t> release() {
+        std::vector<uint8_t> bytes;
+        bytes.swap(m_buffer);
+        return bytes;
+    }
+
+private:
+    std::vector<uint8_t> m_buffer;
+};
+
+#endif // !__IMPL_BYTEARRAYOUTSTREAM
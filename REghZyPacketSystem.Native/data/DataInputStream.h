@@ -45,40 +45,37 @@ public:
         return v;
     }
 
+    // Multi-byte values are big endian, matching DataOutputStream
+
     int16_t readShort() {
-        uint16_t v;
-        m_in->readFully((uint8_t*)&v, 0, 2);
-        return (int16_t)v;
+        return (int16_t)readUShort();
     }
 
     uint16_t readUShort() {
-        uint16_t v;
-        m_in->readFully((uint8_t*)&v, 0, 2);
-        return v;
+        uint8_t v[2];
+        m_in->readFully(v, 0, 2);
+        return (uint16_t)((v[0] << 8) + v[1]);
     }
 
     int32_t readInt() {
-        uint32_t v;
-        m_in->readFully((uint8_t*)&v, 0, 4);
-        return (int32_t)v;
+        return (int32_t)readUInt();
     }
 
     uint32_t readUInt() {
-        uint32_t v;
-        m_in->readFully((uint8_t*)&v, 0, 4);
-        return v;
+        uint8_t v[4];
+        m_in->readFully(v, 0, 4);
+        return ((uint32_t)v[0] << 24) + ((uint32_t)v[1] << 16) + ((uint32_t)v[2] << 8) + v[3];
     }
 
     int64_t readLong() {
-        uint64_t v;
-        m_in->readFully((uint8_t*)&v, 0, 8);
-        return (int64_t)v;
+        return (int64_t)readULong();
     }
 
     uint64_t readULong() {
-        uint64_t v;
-        m_in->readFully((uint8_t*)&v, 0, 8);
-        return v;
+        uint8_t v[8];
+        m_in->readFully(v, 0, 8);
+        return ((uint64_t)v[0] << 56) + ((uint64_t)v[1] << 48) + ((uint64_t)v[2] << 40) + ((uint64_t)v[3] << 32) +
+               ((uint64_t)v[4] << 24) + ((uint64_t)v[5] << 16) + ((uint64_t)v[6] << 8) + v[7];
     }
 
     char readCharUTF8() {
@@ -10,6 +10,14 @@ public:
 		m_wbuf8 = new uint8_t[8];
 	}
 
+	~DataOutputStream() {
+		delete[] m_wbuf8;
+	}
+
+	// Copies would share (and both delete) the write buffer
+	DataOutputStream(const DataOutputStream&) = delete;
+	DataOutputStream& operator=(const DataOutputStream&) = delete;
+
 public:
     void flush() {
         m_out->flush();
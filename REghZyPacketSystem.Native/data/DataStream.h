@@ -13,6 +13,16 @@ public:
         m_data_in = new DataInputStream(m_in);
     }
 
+    // Frees the buffering and data streams this created, but not the given input and output streams
+    virtual ~DataStream() {
+        delete(m_data_out);
+        delete(m_data_in);
+        delete(m_out);
+    }
+
+    DataStream(const DataStream&) = delete;
+    DataStream& operator=(const DataStream&) = delete;
+
     DataOutputStream* getOutput() {
         return m_data_out;
     }
@@ -8,6 +8,8 @@ class InputStream {
 protected:
 	InputStream() { }
 public:
+	virtual ~InputStream() { }
+
     virtual uint16_t read(uint8_t* ptr, uintptr_t ptr_offset, uint16_t count) {
         return count;
     }
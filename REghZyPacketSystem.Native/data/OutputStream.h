@@ -8,6 +8,8 @@ class OutputStream {
 protected:
 	OutputStream() { }
 public:
+	virtual ~OutputStream() { }
+
 	virtual void write(uint8_t* ptr, uintptr_t offset, uint16_t count) { }
 	virtual void write(uint8_t* ptr, uintptr_t offset, uint16_t count, asio::error_code& err) { }
 
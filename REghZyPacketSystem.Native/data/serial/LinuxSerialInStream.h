@@ -0,0 +1,126 @@
+#ifndef __IMPL_LINUXSERIALINSTREAM
+#define __IMPL_LINUXSERIALINSTREAM
+
+#include "../InputStream.h"
+#include "LinuxSerialPort.h"
+
+// An input stream that reads from a LinuxSerialPort in batches. Each read syscall asks for up to
+// the port's readBatch bytes, and the small reads that DataInputStream makes (1, 2 or 4 bytes at
+// a time) are served from that buffer, instead of costing a syscall each
+//
+// If the port is reconfigured with a different readBatch, the buffer is resized once it's empty
+class LinuxSerialInStream : public InputStream {
+public:
+    LinuxSerialInStream(LinuxSerialPort* port) {
+        m_port = port;
+        m_bufsize = port->getConfig().readBatch;
+        m_buffer = new uint8_t[m_bufsize];
+        m_rindex = 0;
+        m_count = 0;
+        m_reads = 0;
+    }
+
+    ~LinuxSerialInStream() {
+        delete[] m_buffer;
+    }
+
+public:
+    uint16_t read(uint8_t* ptr, uintptr_t ptr_offset, uint16_t count) override {
+        asio::error_code err;
+        uint16_t read = this->read(ptr, ptr_offset, count, err);
+        if (err) {
+            throw asio::system_error(err);
+        }
+
+        return read;
+    }
+
+    // Returns buffered bytes if there are any, otherwise does a single read syscall. This can
+    // return 0 if the port uses VTIME with VMIN 0 and nothing arrived before the timeout. With
+    // VMIN above 0, a read that returns nothing means the port hung up, which sets err to eof
+    uint16_t read(uint8_t* ptr, uintptr_t ptr_offset, uint16_t count, asio::error_code& err) override {
+        if (m_rindex == m_count) {
+            uint32_t batch = m_port->getConfig().readBatch;
+            if (batch != m_bufsize) {
+                delete[] m_buffer;
+                m_bufsize = batch;
+                m_buffer = new uint8_t[m_bufsize];
+            }
+
+            if (count >= m_bufsize) {
+                // the caller's buffer is at least as big as ours, so skip the extra copy
+                return (uint16_t)readPort(ptr + ptr_offset, count, err);
+            }
+
+            m_rindex = 0;
+            m_count = readPort(m_buffer, m_bufsize, err);
+            if (m_count == 0) {
+                return 0;
+            }
+        }
+
+        uint32_t available = m_count - m_rindex;
+        if (count > available) {
+            count = (uint16_t)available;
+        }
+
+        memcpy(ptr + ptr_offset, m_buffer + m_rindex, count);
+        m_rindex += count;
+        return count;
+    }
+
+    // The number of bytes already read from the port, but not yet returned
+    uint32_t getBuffered() {
+        return m_count - m_rindex;
+    }
+
+    // The number of read syscalls made so far
+    uint64_t getReadCalls() {
+        return m_reads;
+    }
+
+    void close() override {
+        m_port->close();
+    }
+
+    void close(asio::error_code& err) override {
+        m_port->close();
+    }
+
+    LinuxSerialPort* getPort() {
+        return m_port;
+    }
+
+private:
+    uint32_t readPort(uint8_t* dst, uint32_t count, asio::error_code& err) {
+        while (true) {
+            ssize_t n = ::read(m_port->getFd(), dst, count);
+            m_reads++;
+            if (n > 0) {
+                return (uint32_t)n;
+            }
+            else if (n == 0) {
+                // only a timeout when VMIN is 0; otherwise read blocks until there's data, so 0 is a hangup
+                if (m_port->getConfig().vmin != 0) {
+                    err = asio::error::eof;
+                }
+
+                return 0;
+            }
+
+            if (errno != EINTR) {
+                err = asio::error_code(errno, asio::system_category());
+                return 0;
+            }
+        }
+    }
+
+    LinuxSerialPort* m_port;
+    uint8_t* m_buffer;
+    uint32_t m_bufsize;
+    uint32_t m_rindex;
+    uint32_t m_count;
+    uint64_t m_reads;
+};
+
+#endif // !__IMPL_LINUXSERIALINSTREAM
@@ -0,0 +1,69 @@
+#ifndef __IMPL_LINUXSERIALOUTSTREAM
+#define __IMPL_LINUXSERIALOUTSTREAM
+
+#include "../OutputStream.h"
+#include "LinuxSerialPort.h"
+#include <poll.h>
+
+// An output stream that writes to a LinuxSerialPort. A write only returns once every byte has been
+// handed to the kernel; short writes (the driver's transmit buffer being full) are retried
+class LinuxSerialOutStream : public OutputStream {
+public:
+    LinuxSerialOutStream(LinuxSerialPort* port) {
+        m_port = port;
+    }
+
+public:
+    void write(uint8_t* ptr, uintptr_t offset, uint16_t count) override {
+        asio::error_code err;
+        write(ptr, offset, count, err);
+        if (err) {
+            throw asio::system_error(err);
+        }
+    }
+
+    void write(uint8_t* ptr, uintptr_t offset, uint16_t count, asio::error_code& err) override {
+        uint8_t* src = ptr + offset;
+        while (count != 0) {
+            ssize_t n = ::write(m_port->getFd(), src, count);
+            if (n > 0) {
+                src += n;
+                count -= (uint16_t)n;
+            }
+            else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                // the port was opened non-blocking by someone else, so wait for space
+                pollfd pfd;
+                pfd.fd = m_port->getFd();
+                pfd.events = POLLOUT;
+                poll(&pfd, 1, -1);
+            }
+            else if (n == -1 && errno != EINTR) {
+                err = asio::error_code(errno, asio::system_category());
+                return;
+            }
+        }
+    }
+
+    // The bytes are already with the kernel, which sends them as fast as the baud rate allows.
+    // Use LinuxSerialPort::drain to wait until they've actually been transmitted
+    void flush() override { }
+
+    void flush(asio::error_code& err) override { }
+
+    void close() override {
+        m_port->close();
+    }
+
+    void close(asio::error_code& err) override {
+        m_port->close();
+    }
+
+    LinuxSerialPort* getPort() {
+        return m_port;
+    }
+
+private:
+    LinuxSerialPort* m_port;
+};
+
+#endif // !__IMPL_LINUXSERIALOUTSTREAM
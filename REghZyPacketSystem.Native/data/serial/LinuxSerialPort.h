@@ -0,0 +1,217 @@
+#ifndef __IMPL_LINUXSERIALPORT
+#define __IMPL_LINUXSERIALPORT
+
+#ifndef __linux__
+#error "LinuxSerialPort requires Linux"
+#endif // !__linux__
+
+#include <asio.hpp>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+// How a LinuxSerialPort is tuned. Reads are done in batches of up to readBatch bytes, and
+// VMIN/VTIME decide when the kernel hands a batch back (see termios(3), non-canonical mode)
+struct LinuxSerialConfig {
+    uint32_t baud;
+    uint8_t vmin;       // Minimum bytes before a read returns (0-255)
+    uint8_t vtime;      // Inter-byte timeout, in tenths of a second (0 = none)
+    bool lowLatency;    // Set ASYNC_LOW_LATENCY, so the driver pushes received bytes up without deferring
+    uint16_t readBatch; // The size of the read buffer, and so the most bytes a single read syscall can return
+
+    // Every read returns as soon as a single byte arrives, and the driver doesn't defer received data.
+    // Best for request/response traffic, at the cost of more syscalls per packet
+    static LinuxSerialConfig latencyOptimised(uint32_t baud) {
+        LinuxSerialConfig config;
+        config.baud = baud;
+        config.vmin = 1;
+        config.vtime = 0;
+        config.lowLatency = true;
+        config.readBatch = 4096;
+        return config;
+    }
+
+    // Reads wait for a full batch (or a 100ms gap in the data), so streaming traffic takes far
+    // fewer syscalls, but a lone packet can wait up to 100ms after its last byte
+    static LinuxSerialConfig throughputOptimised(uint32_t baud) {
+        LinuxSerialConfig config;
+        config.baud = baud;
+        config.vmin = 255;
+        config.vtime = 1;
+        config.lowLatency = false;
+        config.readBatch = 4096;
+        return config;
+    }
+};
+
+// A serial port opened and configured directly with termios, rather than through asio::serial_port,
+// so that the batching and latency settings can be controlled. Use it with LinuxSerialInStream
+// and LinuxSerialOutStream. It can also wrap an already open terminal, such as a pty
+class LinuxSerialPort {
+public:
+    static LinuxSerialPort* open(const char* path, const LinuxSerialConfig& config, asio::error_code& err) {
+        int fd = ::open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (fd == -1) {
+            err = asio::error_code(errno, asio::system_category());
+            return nullptr;
+        }
+
+        LinuxSerialPort* port = attach(fd, config, err);
+        if (port == nullptr) {
+            ::close(fd);
+        }
+
+        return port;
+    }
+
+    // Wraps an open terminal file descriptor. The port takes ownership of it, unless this fails
+    static LinuxSerialPort* attach(int fd, const LinuxSerialConfig& config, asio::error_code& err) {
+        LinuxSerialPort* port = new LinuxSerialPort(fd);
+        port->configure(config, err);
+        if (err) {
+            port->m_fd = -1;
+            delete(port);
+            return nullptr;
+        }
+
+        return port;
+    }
+
+    ~LinuxSerialPort() {
+        close();
+    }
+
+public:
+    // Applies the given settings. This can be called again at any time to switch modes
+    void configure(const LinuxSerialConfig& config, asio::error_code& err) {
+        termios tio;
+        if (tcgetattr(m_fd, &tio) == -1) {
+            err = asio::error_code(errno, asio::system_category());
+            return;
+        }
+
+        speed_t speed = toSpeed(config.baud);
+        if (speed == B0) {
+            err = asio::error::invalid_argument;
+            return;
+        }
+
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+        tio.c_cc[VMIN] = config.vmin;
+        tio.c_cc[VTIME] = config.vtime;
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        if (tcsetattr(m_fd, TCSANOW, &tio) == -1) {
+            err = asio::error_code(errno, asio::system_category());
+            return;
+        }
+
+        // not every driver supports this (ptys and some USB adapters don't), so that isn't an error
+        m_lowLatency = false;
+        serial_struct serial;
+        if (ioctl(m_fd, TIOCGSERIAL, &serial) == 0) {
+            if (config.lowLatency) {
+                serial.flags |= ASYNC_LOW_LATENCY;
+            }
+            else {
+                serial.flags &= ~ASYNC_LOW_LATENCY;
+            }
+
+            m_lowLatency = ioctl(m_fd, TIOCSSERIAL, &serial) == 0 && config.lowLatency;
+        }
+
+        m_config = config;
+        if (m_config.readBatch == 0) {
+            m_config.readBatch = 1;
+        }
+    }
+
+    // Sets the latency timer of an FTDI USB adapter (e.g. "ttyUSB0"), which otherwise holds back
+    // received bytes for up to 16ms. This is a sysfs setting, so it usually needs root
+    static void setFtdiLatencyTimer(const char* ttyName, uint8_t millis, asio::error_code& err) {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/bus/usb-serial/devices/%s/latency_timer", ttyName);
+        FILE* file = fopen(path, "w");
+        if (file == nullptr) {
+            err = asio::error_code(errno, asio::system_category());
+            return;
+        }
+
+        fprintf(file, "%u", millis);
+        if (fclose(file) != 0) {
+            err = asio::error_code(errno, asio::system_category());
+        }
+    }
+
+    // Blocks until everything written so far has actually been transmitted
+    void drain(asio::error_code& err) {
+        if (tcdrain(m_fd) == -1) {
+            err = asio::error_code(errno, asio::system_category());
+        }
+    }
+
+    void close() {
+        if (m_fd != -1) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    int getFd() {
+        return m_fd;
+    }
+
+    const LinuxSerialConfig& getConfig() {
+        return m_config;
+    }
+
+    // Whether ASYNC_LOW_LATENCY was requested and the driver accepted it
+    bool isLowLatency() {
+        return m_lowLatency;
+    }
+
+private:
+    LinuxSerialPort(int fd) {
+        m_fd = fd;
+        m_lowLatency = false;
+        m_config = LinuxSerialConfig::latencyOptimised(9600);
+    }
+
+    static speed_t toSpeed(uint32_t baud) {
+        switch (baud) {
+            case 1200: return B1200;
+            case 2400: return B2400;
+            case 4800: return B4800;
+            case 9600: return B9600;
+            case 19200: return B19200;
+            case 38400: return B38400;
+            case 57600: return B57600;
+            case 115200: return B115200;
+            case 230400: return B230400;
+            case 460800: return B460800;
+            case 500000: return B500000;
+            case 576000: return B576000;
+            case 921600: return B921600;
+            case 1000000: return B1000000;
+            case 1500000: return B1500000;
+            case 2000000: return B2000000;
+            case 3000000: return B3000000;
+            case 4000000: return B4000000;
+            default: return B0;
+        }
+    }
+
+    int m_fd;
+    bool m_lowLatency;
+    LinuxSerialConfig m_config;
+};
+
+#endif // !__IMPL_LINUXSERIALPORT
@@ -18,12 +18,14 @@ public:
     }
 
 public:
+    // write_some may only write part of the buffer (e.g. when the device's
+    // transmit queue is full), so asio::write is used to loop until it's all gone
     void write(uint8_t* ptr, uintptr_t offset, uint16_t count) override {
-        m_port->write_some(asio::buffer(ptr + offset, count));
+        asio::write(*m_port, asio::buffer(ptr + offset, count));
     }
 
     void write(uint8_t* ptr, uintptr_t offset, uint16_t count, asio::error_code& err) override {
-        m_port->write_some(asio::buffer(ptr + offset, count), err);
+        asio::write(*m_port, asio::buffer(ptr + offset, count), err);
     }
 
     void close() {
@@ -0,0 +1,62 @@
+#ifndef __IMPL_SHAREDMEMINSTREAM
+#define __IMPL_SHAREDMEMINSTREAM
+
+#include "../InputStream.h"
+#include "SharedMemoryRing.h"
+
+// An input stream that reads from a shared memory ring, written by a SharedMemOutStream in another process
+class SharedMemInStream : public InputStream {
+public:
+    SharedMemInStream(SharedMemoryRing* ring) {
+        m_ring = ring;
+        m_ring->attachConsumer();
+    }
+
+public:
+    uint16_t read(uint8_t* ptr, uintptr_t ptr_offset, uint16_t count) override {
+        asio::error_code err;
+        uint16_t read = this->read(ptr, ptr_offset, count, err);
+        if (err) {
+            throw asio::system_error(err);
+        }
+
+        return read;
+    }
+
+    // Blocks until at least 1 byte is available, and then reads as much as possible (up to count)
+    uint16_t read(uint8_t* ptr, uintptr_t ptr_offset, uint16_t count, asio::error_code& err) override {
+        uint32_t read = m_ring->tryRead(ptr + ptr_offset, count);
+        if (read == 0 && count != 0) {
+            if (!m_ring->waitReadable()) {
+                err = asio::error::eof;
+                return 0;
+            }
+
+            read = m_ring->tryRead(ptr + ptr_offset, count);
+        }
+
+        return (uint16_t)read;
+    }
+
+    // The number of bytes that can be read without blocking
+    uint32_t getBytesReadable() {
+        return m_ring->getReadable();
+    }
+
+    void close() override {
+        m_ring->close();
+    }
+
+    void close(asio::error_code& err) override {
+        m_ring->close();
+    }
+
+    SharedMemoryRing* getRing() {
+        return m_ring;
+    }
+
+private:
+    SharedMemoryRing* m_ring;
+};
+
+#endif // !__IMPL_SHAREDMEMINSTREAM
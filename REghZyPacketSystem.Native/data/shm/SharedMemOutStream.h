@@ -0,0 +1,72 @@
+#ifndef __IMPL_SHAREDMEMOUTSTREAM
+#define __IMPL_SHAREDMEMOUTSTREAM
+
+#include "../OutputStream.h"
+#include "SharedMemoryRing.h"
+
+// An output stream that writes into a shared memory ring, read by a SharedMemInStream in another process
+//
+// The bytes are visible to the reader as soon as write returns, so flush does nothing. When used in a
+// DataStream, the BufferedOutStream batches small writes, so a packet that fits in its buffer is published
+// in one go. Bigger packets are published in pieces, and the reader may see the start of one before the rest
+class SharedMemOutStream : public OutputStream {
+public:
+    SharedMemOutStream(SharedMemoryRing* ring) {
+        m_ring = ring;
+        m_ring->attachProducer();
+    }
+
+public:
+    void write(uint8_t* ptr, uintptr_t offset, uint16_t count) override {
+        asio::error_code err;
+        write(ptr, offset, count, err);
+        if (err) {
+            throw asio::system_error(err);
+        }
+    }
+
+    // Blocks until all of the bytes have been copied into the ring
+    void write(uint8_t* ptr, uintptr_t offset, uint16_t count, asio::error_code& err) override {
+        uint8_t* src = ptr + offset;
+        while (count != 0) {
+            if (m_ring->isClosed()) {
+                err = asio::error::broken_pipe;
+                return;
+            }
+
+            uint32_t written = m_ring->tryWrite(src, count);
+            if (written == 0) {
+                if (!m_ring->waitWritable()) {
+                    err = asio::error::broken_pipe;
+                    return;
+                }
+
+                continue;
+            }
+
+            src += written;
+            count -= (uint16_t)written;
+        }
+    }
+
+    void flush() override { }
+
+    void flush(asio::error_code& err) override { }
+
+    void close() override {
+        m_ring->close();
+    }
+
+    void close(asio::error_code& err) override {
+        m_ring->close();
+    }
+
+    SharedMemoryRing* getRing() {
+        return m_ring;
+    }
+
+private:
+    SharedMemoryRing* m_ring;
+};
+
+#endif // !__IMPL_SHAREDMEMOUTSTREAM
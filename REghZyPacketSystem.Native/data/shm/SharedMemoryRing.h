@@ -0,0 +1,374 @@
+#ifndef __IMPL_SHAREDMEMORYRING
+#define __IMPL_SHAREDMEMORYRING
+
+#ifndef __linux__
+#error "SharedMemoryRing requires Linux (memfd/shm_open and futex)"
+#endif // !__linux__
+
+#include <asio.hpp>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <ctime>
+#include <linux/futex.h>
+#include <new>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define SHM_RING_MAGIC 0x727A3231 // 'rz21'
+#define SHM_RING_SPIN_COUNT 2000  // Default number of times to poll the ring before sleeping on the futex
+#define SHM_RING_LIVENESS_MS 100  // How often a sleeping side wakes up to check that the other process still exists
+#define SHM_RING_MIN_CAPACITY 64
+#define SHM_RING_MAX_CAPACITY 0x40000000
+
+// The indices are shared between processes, which only works if the atomics don't fall back to a (process local) lock
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "SharedMemoryRing needs lock free 64 bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "SharedMemoryRing needs lock free 32 bit atomics");
+
+// The control block at the start of the mapping. The producer and consumer
+// fields are kept on separate cache lines, so that they don't bounce between cores
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t capacity;
+    std::atomic<uint32_t> closed;
+    std::atomic<int32_t> producerPid;                // 0 until a SharedMemOutStream attaches
+    std::atomic<int32_t> consumerPid;                // 0 until a SharedMemInStream attaches
+
+    alignas(64) std::atomic<uint64_t> head;          // Total bytes written; only the producer stores this
+    std::atomic<uint32_t> dataSeq;                   // Futex word the consumer sleeps on while the ring is empty
+    std::atomic<uint32_t> readerWaiting;
+
+    alignas(64) std::atomic<uint64_t> tail;          // Total bytes read; only the consumer stores this
+    std::atomic<uint32_t> spaceSeq;                  // Futex word the producer sleeps on while the ring is full
+    std::atomic<uint32_t> writerWaiting;
+};
+
+#define SHM_RING_DATA_OFFSET ((sizeof(ShmRingHeader) + 63) & ~(size_t)63)
+
+// A single producer, single consumer byte ring in shared memory, for passing data between two
+// processes on the same host without going through the kernel. Copying data in or out is just a
+// memcpy; the futex syscalls are only made when the other side is actually asleep
+//
+// A ring only carries data one way, so a duplex connection uses 2 rings (see SharedMemInStream
+// and SharedMemOutStream). The mapping is either a named shm_open object, or an anonymous
+// memfd whose file descriptor is handed to the other process (fork, or SCM_RIGHTS)
+//
+// A side that's asleep waiting for the other wakes up every SHM_RING_LIVENESS_MS to check that the other
+// process still exists, and treats the ring as closed if it doesn't, so a crashed peer can't block it forever.
+// The check uses the pids stored by attachProducer and attachConsumer, so both processes must be in the same pid namespace
+class SharedMemoryRing {
+public:
+    // Creates a ring in a new named shared memory object. The capacity is rounded up to a power of 2
+    static SharedMemoryRing* createNamed(const char* name, uint32_t capacity, asio::error_code& err) {
+        int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd == -1) {
+            err = asio::error_code(errno, asio::system_category());
+            return nullptr;
+        }
+
+        SharedMemoryRing* ring = create(fd, capacity, err);
+        if (ring == nullptr) {
+            shm_unlink(name);
+        }
+
+        return ring;
+    }
+
+    // Opens a ring that another process created with createNamed
+    static SharedMemoryRing* openNamed(const char* name, asio::error_code& err) {
+        int fd = shm_open(name, O_RDWR, 0600);
+        if (fd == -1) {
+            err = asio::error_code(errno, asio::system_category());
+            return nullptr;
+        }
+
+        return open(fd, err);
+    }
+
+    // Creates a ring in an anonymous memfd. Use getFd to pass it to the other process
+    static SharedMemoryRing* createAnonymous(uint32_t capacity, asio::error_code& err) {
+        int fd = (int)syscall(SYS_memfd_create, "rz-shm-ring", 0);
+        if (fd == -1) {
+            err = asio::error_code(errno, asio::system_category());
+            return nullptr;
+        }
+
+        return create(fd, capacity, err);
+    }
+
+    // Maps a ring from a file descriptor that already contains one (e.g. a memfd received from
+    // another process). The ring takes ownership of the file descriptor
+    static SharedMemoryRing* open(int fd, asio::error_code& err) {
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            err = asio::error_code(errno, asio::system_category());
+            ::close(fd);
+            return nullptr;
+        }
+
+        if ((size_t)st.st_size < SHM_RING_DATA_OFFSET) {
+            err = asio::error::invalid_argument;
+            ::close(fd);
+            return nullptr;
+        }
+
+        void* map = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            err = asio::error_code(errno, asio::system_category());
+            ::close(fd);
+            return nullptr;
+        }
+
+        // the indices are masked with capacity - 1, so anything but a power of 2 would corrupt them
+        ShmRingHeader* header = (ShmRingHeader*)map;
+        uint32_t capacity = header->capacity;
+        if (header->magic != SHM_RING_MAGIC || capacity < SHM_RING_MIN_CAPACITY || capacity > SHM_RING_MAX_CAPACITY ||
+            (capacity & (capacity - 1)) != 0 || (SHM_RING_DATA_OFFSET + capacity) != (size_t)st.st_size) {
+            err = asio::error::invalid_argument;
+            munmap(map, (size_t)st.st_size);
+            ::close(fd);
+            return nullptr;
+        }
+
+        return new SharedMemoryRing(fd, map, (size_t)st.st_size);
+    }
+
+    ~SharedMemoryRing() {
+        munmap(m_map, m_mapsize);
+        ::close(m_fd);
+    }
+
+public:
+    // Copies up to count bytes into the ring, without waiting. Returns the number of bytes copied
+    uint32_t tryWrite(const uint8_t* src, uint32_t count) {
+        uint64_t head = m_header->head.load(std::memory_order_relaxed);
+        uint64_t tail = m_header->tail.load(std::memory_order_acquire);
+        uint32_t space = m_capacity - (uint32_t)(head - tail);
+        if (count > space) {
+            count = space;
+        }
+
+        if (count == 0) {
+            return 0;
+        }
+
+        uint32_t pos = (uint32_t)head & m_mask;
+        uint32_t first = m_capacity - pos;
+        if (first >= count) {
+            memcpy(m_data + pos, src, count);
+        }
+        else {
+            memcpy(m_data + pos, src, first);
+            memcpy(m_data, src + first, count - first);
+        }
+
+        m_header->head.store(head + count, std::memory_order_release);
+        wake(m_header->readerWaiting, m_header->dataSeq);
+        return count;
+    }
+
+    // Copies up to count bytes out of the ring, without waiting. Returns the number of bytes copied
+    uint32_t tryRead(uint8_t* dst, uint32_t count) {
+        uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+        uint64_t head = m_header->head.load(std::memory_order_acquire);
+        uint32_t available = (uint32_t)(head - tail);
+        if (count > available) {
+            count = available;
+        }
+
+        if (count == 0) {
+            return 0;
+        }
+
+        uint32_t pos = (uint32_t)tail & m_mask;
+        uint32_t first = m_capacity - pos;
+        if (first >= count) {
+            memcpy(dst, m_data + pos, count);
+        }
+        else {
+            memcpy(dst, m_data + pos, first);
+            memcpy(dst + first, m_data, count - first);
+        }
+
+        m_header->tail.store(tail + count, std::memory_order_release);
+        wake(m_header->writerWaiting, m_header->spaceSeq);
+        return count;
+    }
+
+    // Blocks until there's data to read. Returns false if the ring was closed (or the producer died) and is empty
+    bool waitReadable() {
+        return waitFor(m_header->readerWaiting, m_header->dataSeq, m_header->producerPid, [this]() { return getReadable() != 0; });
+    }
+
+    // Blocks until there's space to write. Returns false if the ring was closed (or the consumer died)
+    bool waitWritable() {
+        return waitFor(m_header->writerWaiting, m_header->spaceSeq, m_header->consumerPid, [this]() { return getWritable() != 0; }) && !isClosed();
+    }
+
+    // Records this process as the one that writes to the ring, so the consumer can tell if it dies
+    void attachProducer() {
+        m_header->producerPid.store((int32_t)getpid(), std::memory_order_release);
+    }
+
+    // Records this process as the one that reads from the ring, so the producer can tell if it dies
+    void attachConsumer() {
+        m_header->consumerPid.store((int32_t)getpid(), std::memory_order_release);
+    }
+
+    uint32_t getReadable() {
+        return (uint32_t)(m_header->head.load(std::memory_order_acquire) - m_header->tail.load(std::memory_order_relaxed));
+    }
+
+    uint32_t getWritable() {
+        return m_capacity - (uint32_t)(m_header->head.load(std::memory_order_relaxed) - m_header->tail.load(std::memory_order_acquire));
+    }
+
+    // Marks the ring as closed, and wakes up both sides. Buffered data can still be read
+    void close() {
+        m_header->closed.store(1, std::memory_order_seq_cst);
+        m_header->dataSeq.fetch_add(1, std::memory_order_seq_cst);
+        m_header->spaceSeq.fetch_add(1, std::memory_order_seq_cst);
+        futex(m_header->dataSeq, FUTEX_WAKE, INT_MAX);
+        futex(m_header->spaceSeq, FUTEX_WAKE, INT_MAX);
+    }
+
+    bool isClosed() {
+        return m_header->closed.load(std::memory_order_acquire) != 0;
+    }
+
+    // How many times to poll the ring before sleeping on the futex. Spinning is what gives sub-microsecond
+    // handoff, but it only helps when the other process is running on another core at the same time
+    void setSpinCount(uint32_t spins) {
+        m_spins = spins;
+    }
+
+    uint32_t getCapacity() {
+        return m_capacity;
+    }
+
+    // The file descriptor of the shared memory, for passing the ring to another process
+    int getFd() {
+        return m_fd;
+    }
+
+private:
+    SharedMemoryRing(int fd, void* map, size_t mapsize) {
+        m_fd = fd;
+        m_map = map;
+        m_mapsize = mapsize;
+        m_header = (ShmRingHeader*)map;
+        m_data = (uint8_t*)map + SHM_RING_DATA_OFFSET;
+        m_capacity = m_header->capacity;
+        m_mask = m_capacity - 1;
+        m_spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SHM_RING_SPIN_COUNT : 0;
+    }
+
+    static SharedMemoryRing* create(int fd, uint32_t capacity, asio::error_code& err) {
+        if (capacity < SHM_RING_MIN_CAPACITY || capacity > SHM_RING_MAX_CAPACITY) {
+            err = asio::error::invalid_argument;
+            ::close(fd);
+            return nullptr;
+        }
+
+        uint32_t cap = SHM_RING_MIN_CAPACITY;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+
+        size_t mapsize = SHM_RING_DATA_OFFSET + cap;
+        if (ftruncate(fd, (off_t)mapsize) == -1) {
+            err = asio::error_code(errno, asio::system_category());
+            ::close(fd);
+            return nullptr;
+        }
+
+        void* map = mmap(nullptr, mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            err = asio::error_code(errno, asio::system_category());
+            ::close(fd);
+            return nullptr;
+        }
+
+        // the new mapping is zero filled, so only the non-zero fields need setting
+        ShmRingHeader* header = new (map) ShmRingHeader();
+        header->capacity = cap;
+        header->magic = SHM_RING_MAGIC;
+        return new SharedMemoryRing(fd, map, mapsize);
+    }
+
+    static long futex(std::atomic<uint32_t>& word, int op, uint32_t val, const timespec* timeout = nullptr) {
+        // not FUTEX_PRIVATE_FLAG, because the word is shared with another process
+        return syscall(SYS_futex, (uint32_t*)&word, op, val, timeout, nullptr, 0);
+    }
+
+    // Whether the process with the given pid (0 meaning not attached yet) might still be running
+    static bool isAlive(int32_t pid) {
+        return pid == 0 || kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+    }
+
+    // Called after publishing an index. The seq_cst fence pairs with the one in waitFor, so
+    // either this sees the waiting flag, or the waiter sees the new index before sleeping
+    static void wake(std::atomic<uint32_t>& waiting, std::atomic<uint32_t>& seq) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed)) {
+            seq.fetch_add(1, std::memory_order_release);
+            futex(seq, FUTEX_WAKE, 1);
+        }
+    }
+
+    template<typename Ready>
+    bool waitFor(std::atomic<uint32_t>& waiting, std::atomic<uint32_t>& seq, std::atomic<int32_t>& peerPid, Ready ready) {
+        timespec timeout;
+        timeout.tv_sec = SHM_RING_LIVENESS_MS / 1000;
+        timeout.tv_nsec = (SHM_RING_LIVENESS_MS % 1000) * 1000000L;
+        while (true) {
+            for (uint32_t i = 0; i < m_spins; i++) {
+                if (ready()) {
+                    return true;
+                }
+
+                if (isClosed()) {
+                    return ready();
+                }
+
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#endif
+            }
+
+            uint32_t value = seq.load(std::memory_order_acquire);
+            waiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool isReady = ready();
+            if (isReady || isClosed()) {
+                waiting.store(0, std::memory_order_relaxed);
+                return isReady;
+            }
+
+            long result = futex(seq, FUTEX_WAIT, value, &timeout);
+            waiting.store(0, std::memory_order_relaxed);
+            if (result == -1 && errno == ETIMEDOUT && !isAlive(peerPid.load(std::memory_order_acquire))) {
+                // the other process went away without closing the ring (e.g. it crashed), so close it for it
+                m_header->closed.store(1, std::memory_order_seq_cst);
+                return ready();
+            }
+        }
+    }
+
+    int m_fd;
+    void* m_map;
+    size_t m_mapsize;
+    ShmRingHeader* m_header;
+    uint8_t* m_data;
+    uint32_t m_capacity;
+    uint32_t m_mask;
+    uint32_t m_spins;
+};
+
+#endif // !__IMPL_SHAREDMEMORYRING
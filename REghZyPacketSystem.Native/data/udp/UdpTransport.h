@@ -0,0 +1,657 @@
+#ifndef __IMPL_UDPTRANSPORT
+#define __IMPL_UDPTRANSPORT
+
+#ifndef __linux__
+#error "UdpTransport requires Linux"
+#endif // !__linux__
+
+#include <asio.hpp>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../../packets/Packet.h"
+#include "../ByteArrayInStream.h"
+#include "../ByteArrayOutStream.h"
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif // !UDP_SEGMENT
+
+#define UDP_DEFAULT_MAX_DATAGRAM 1472 // a 1500 byte MTU, minus the IPv4 and UDP headers
+#define UDP_RECV_BUFFER_LEN 2048      // bigger than any datagram this transport sends
+#define UDP_DEFAULT_RECV_BATCH 64
+#define UDP_MAX_GSO_SEGMENTS 64
+#define UDP_MAX_GSO_BYTES 65000
+#define UDP_DEFAULT_MAX_PEERS 1024
+
+// A remote address that packets are sent to or received from. Peers are owned by their UdpTransport
+class UdpPeer {
+public:
+    ~UdpPeer() {
+        delete(m_data);
+    }
+
+public:
+    const sockaddr* getAddress() {
+        return (const sockaddr*) &m_addr;
+    }
+
+    socklen_t getAddressLength() {
+        return m_addrLen;
+    }
+
+    // The address as text, e.g. "192.168.1.20:5000"
+    std::string toString() {
+        char host[INET6_ADDRSTRLEN];
+        uint16_t port;
+        if (m_addr.ss_family == AF_INET6) {
+            sockaddr_in6* addr = (sockaddr_in6*) &m_addr;
+            inet_ntop(AF_INET6, &addr->sin6_addr, host, sizeof(host));
+            port = ntohs(addr->sin6_port);
+            return "[" + std::string(host) + "]:" + std::to_string(port);
+        }
+
+        sockaddr_in* addr = (sockaddr_in*) &m_addr;
+        inet_ntop(AF_INET, &addr->sin_addr, host, sizeof(host));
+        port = ntohs(addr->sin_port);
+        return std::string(host) + ":" + std::to_string(port);
+    }
+
+    // Anything the application wants to associate with this peer (e.g. its device state)
+    void* getUserData() { return m_userData; }
+
+    void setUserData(void* data) { m_userData = data; }
+
+    uint64_t getPacketsSent() { return m_packetsSent; }
+
+    uint64_t getPacketsReceived() { return m_packetsReceived; }
+
+    uint64_t getDatagramsSent() { return m_datagramsSent; }
+
+    uint64_t getDatagramsReceived() { return m_datagramsReceived; }
+
+    // The number of received datagrams that held a frame that couldn't be decoded
+    uint64_t getDecodeErrors() { return m_decodeErrors; }
+
+private:
+    friend class UdpTransport;
+
+    UdpPeer(const sockaddr* addr, socklen_t len) {
+        memset(&m_addr, 0, sizeof(m_addr));
+        memcpy(&m_addr, addr, len);
+        m_addrLen = len;
+        m_data = new DataOutputStream(&m_pending);
+        m_userData = nullptr;
+        m_packetsSent = 0;
+        m_packetsReceived = 0;
+        m_datagramsSent = 0;
+        m_datagramsReceived = 0;
+        m_decodeErrors = 0;
+    }
+
+    sockaddr_storage m_addr;
+    socklen_t m_addrLen;
+    ByteArrayOutStream m_pending; // the datagram being filled with frames
+    DataOutputStream* m_data;
+    void* m_userData;
+    uint64_t m_packetsSent;
+    uint64_t m_packetsReceived;
+    uint64_t m_datagramsSent;
+    uint64_t m_datagramsReceived;
+    uint64_t m_decodeErrors;
+};
+
+// A datagram transport, where each datagram carries one or more whole frames (in the same format as Packet::writePacket)
+//
+// Sent packets are coalesced per peer into datagrams of up to the max datagram size, and flush sends every
+// pending datagram with sendmmsg, so one syscall sends many datagrams. With GSO enabled, a run of equally
+// sized datagrams to the same peer goes down as a single message, and the kernel (or NIC) splits it up
+//
+// Received datagrams are read with recvmmsg, in batches. Each one is matched to the peer that sent it, and
+// its frames are decoded with Packet::readPacket, then handed out one at a time by readPacket. A datagram is
+// either delivered whole or not at all, so a frame that can't be decoded drops the rest of its datagram
+//
+// send/flush and readPacket may be called on different threads, but neither may be called by two threads at once.
+// Peers are only created by addPeer and (when unknown peers are accepted) readPacket, so call addPeer before
+// starting the reading thread if both threads need to create peers. A peer is kept until removePeer is called,
+// so a transport that accepts unknown peers should remove the ones it's done with; otherwise every new source
+// address would take up memory until the peer limit is reached
+class UdpTransport {
+public:
+    // Binds a UDP socket to the given local address. host may be null for any address, and port may be 0 for any port
+    static UdpTransport* open(const char* host, uint16_t port, asio::error_code& err) {
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* result;
+        std::string service = std::to_string(port);
+        int status = getaddrinfo(host, service.c_str(), &hints, &result);
+        if (status != 0) {
+            err = asio::error::host_not_found;
+            return nullptr;
+        }
+
+        int fd = socket(result->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+        if (fd == -1 || bind(fd, result->ai_addr, result->ai_addrlen) == -1) {
+            err = asio::error_code(errno, asio::system_category());
+            if (fd != -1) {
+                ::close(fd);
+            }
+
+            freeaddrinfo(result);
+            return nullptr;
+        }
+
+        freeaddrinfo(result);
+        return new UdpTransport(fd);
+    }
+
+    ~UdpTransport() {
+        close();
+        for (auto& entry : m_peers) {
+            delete(entry.second);
+        }
+
+        for (Received& received : m_received) {
+            delete(received.packet);
+        }
+    }
+
+public:
+    // Gets the peer at the given address (resolving it if it's a host name), creating it if needed
+    UdpPeer* addPeer(const char* host, uint16_t port, asio::error_code& err) {
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = m_family;
+        hints.ai_socktype = SOCK_DGRAM;
+        hints.ai_flags = m_family == AF_INET6 ? AI_V4MAPPED : 0;
+        addrinfo* result;
+        std::string service = std::to_string(port);
+        if (getaddrinfo(host, service.c_str(), &hints, &result) != 0) {
+            err = asio::error::host_not_found;
+            return nullptr;
+        }
+
+        UdpPeer* peer = getOrCreatePeer(result->ai_addr, result->ai_addrlen);
+        freeaddrinfo(result);
+        return peer;
+    }
+
+    // Adds the packet to the peer's current datagram, starting a new one if it doesn't fit. Nothing is
+    // sent until flush is called, so the caller should flush once it has nothing more to send right now
+    uint8_t send(UdpPeer* peer, Packet* packet) {
+        size_t size = PACKET_HEADER_LEN + packet->getPayloadSize();
+        if (size > m_maxDatagram) {
+            return PACKET_ERRCODE::INVALID_PACKET_SZ;
+        }
+
+        size_t start = peer->m_pending.size();
+        if ((start + size) > m_maxDatagram) {
+            closeDatagram(peer);
+            start = 0;
+        }
+
+        uint8_t err = Packet::writePacket(peer->m_data, packet);
+        if (err || peer->m_pending.size() != (start + size)) {
+            peer->m_pending.truncate(start);
+            return err ? err : (uint8_t) PACKET_ERRCODE::INVALID_PACKET_SZ;
+        }
+
+        if (start == 0) {
+            m_openPeers.push_back(peer);
+        }
+
+        peer->m_packetsSent++;
+        return PKT_WRITE_SUCCESS;
+    }
+
+    // Sends every pending datagram, to every peer
+    void flush(asio::error_code& err) {
+        for (UdpPeer* peer : m_openPeers) {
+            closeDatagram(peer);
+        }
+
+        m_openPeers.clear();
+        size_t sent = 0;
+        while (sent < m_datagrams.size()) {
+            size_t count = buildMessages(sent);
+            size_t msg = 0;
+            while (msg < count) {
+                int n = sendmmsg(m_fd, m_smsgs.data() + msg, (unsigned int)(count - msg), 0);
+                m_sendCalls++;
+                if (n >= 0) {
+                    msg += n;
+                    continue;
+                }
+                else if (errno == EINTR) {
+                    continue;
+                }
+                else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    pollfd pfd;
+                    pfd.fd = m_fd;
+                    pfd.events = POLLOUT;
+                    poll(&pfd, 1, -1);
+                    continue;
+                }
+                else if (errno == EIO && m_gso) {
+                    // the device can't do segmentation offload, so send the rest without it
+                    m_gso = false;
+                    break;
+                }
+
+                err = asio::error_code(errno, asio::system_category());
+                m_datagrams.clear();
+                m_arena.reset();
+                return;
+            }
+
+            for (size_t i = 0; i < msg; i++) {
+                m_datagrams[m_msgFirst[i]].peer->m_datagramsSent += m_msgSegments[i];
+            }
+
+            // every datagram before the first unsent message has gone
+            sent = msg < count ? m_msgFirst[msg] : m_datagrams.size();
+        }
+
+        m_datagrams.clear();
+        m_arena.reset();
+    }
+
+    // Returns the next received packet, and sets peer to who sent it. This blocks until a datagram arrives
+    // (or the receive timeout passes), then decodes the whole batch that recvmmsg returned
+    //
+    // If a frame couldn't be decoded, this returns nullptr, sets peer, and sets err as Packet::readPacket would.
+    // If the socket failed or timed out, this returns nullptr and sets ec
+    Packet* readPacket(UdpPeer*& peer, uint16_t& err, asio::error_code& ec) {
+        while (m_received.empty()) {
+            if (!receiveBatch(ec)) {
+                peer = nullptr;
+                err = 0;
+                return nullptr;
+            }
+        }
+
+        Received received = m_received.front();
+        m_received.pop_front();
+        peer = received.peer;
+        err = received.err;
+        return received.packet;
+    }
+
+    // Whether datagrams from addresses that weren't added with addPeer are accepted (as new peers). Defaults to false
+    void setAcceptUnknownPeers(bool accept) {
+        m_acceptUnknown = accept;
+    }
+
+    // The most peers there can be before datagrams from unknown addresses are dropped, rather than creating
+    // more. addPeer isn't limited by it, but its peers count towards it. Defaults to UDP_DEFAULT_MAX_PEERS
+    void setMaxPeers(size_t max) {
+        m_maxPeers = max;
+    }
+
+    size_t getPeerCount() { return m_peers.size(); }
+
+    // Forgets the peer and deletes it, along with its unsent packets and any of its received packets that
+    // readPacket hasn't handed out yet. Neither send/flush nor readPacket may be running on another thread
+    void removePeer(UdpPeer* peer) {
+        for (size_t i = 0; i < m_openPeers.size(); i++) {
+            if (m_openPeers[i] == peer) {
+                m_openPeers.erase(m_openPeers.begin() + i);
+                break;
+            }
+        }
+
+        for (auto it = m_received.begin(); it != m_received.end();) {
+            if (it->peer == peer) {
+                delete(it->packet);
+                it = m_received.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        m_peers.erase(keyOf(peer->getAddress()));
+        delete(peer);
+    }
+
+    // Enables UDP generic segmentation offload, if the kernel supports it. Returns whether it's now enabled
+    bool setGso(bool enabled) {
+        if (enabled) {
+            // the per-message size is given with each send; this only checks that the kernel knows UDP_SEGMENT
+            int size = 0;
+            enabled = setsockopt(m_fd, SOL_UDP, UDP_SEGMENT, &size, sizeof(size)) == 0;
+        }
+
+        m_gso = enabled;
+        return m_gso;
+    }
+
+    // The largest datagram to send. This should fit the path MTU, so datagrams aren't fragmented
+    void setMaxDatagram(uint16_t size) {
+        m_maxDatagram = size < (PACKET_HEADER_LEN + MAX_PAYLOAD_LEN) ? (PACKET_HEADER_LEN + MAX_PAYLOAD_LEN) : size;
+        if (m_maxDatagram > UDP_RECV_BUFFER_LEN) {
+            m_maxDatagram = UDP_RECV_BUFFER_LEN;
+        }
+    }
+
+    // How long readPacket waits for a datagram, or 0 to wait forever
+    void setReceiveTimeout(uint32_t millis) {
+        timeval tv;
+        tv.tv_sec = millis / 1000;
+        tv.tv_usec = (millis % 1000) * 1000;
+        setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
+    // The local port, which is useful after opening with port 0
+    uint16_t getLocalPort() {
+        sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        getsockname(m_fd, (sockaddr*) &addr, &len);
+        return ntohs(addr.ss_family == AF_INET6 ? ((sockaddr_in6*) &addr)->sin6_port : ((sockaddr_in*) &addr)->sin_port);
+    }
+
+    int getFd() { return m_fd; }
+
+    bool isGso() { return m_gso; }
+
+    uint64_t getSendCalls() { return m_sendCalls; }
+
+    uint64_t getRecvCalls() { return m_recvCalls; }
+
+    // The number of received datagrams that were dropped, because they were truncated or came from an unknown peer that wasn't accepted
+    uint64_t getDroppedDatagrams() { return m_dropped; }
+
+    void close() {
+        if (m_fd != -1) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+private:
+    struct Datagram {
+        UdpPeer* peer;
+        size_t offset; // in m_arena
+        size_t length;
+    };
+
+    struct Received {
+        UdpPeer* peer;
+        Packet* packet;
+        uint16_t err;
+    };
+
+    UdpTransport(int fd) {
+        m_fd = fd;
+        sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        getsockname(fd, (sockaddr*) &addr, &len);
+        m_family = addr.ss_family;
+        m_maxDatagram = UDP_DEFAULT_MAX_DATAGRAM;
+        m_gso = false;
+        m_acceptUnknown = false;
+        m_maxPeers = UDP_DEFAULT_MAX_PEERS;
+        m_sendCalls = 0;
+        m_recvCalls = 0;
+        m_dropped = 0;
+
+        m_recvBatch = UDP_DEFAULT_RECV_BATCH;
+        m_rbuf.resize(m_recvBatch * UDP_RECV_BUFFER_LEN);
+        m_raddrs.resize(m_recvBatch);
+        m_riovs.resize(m_recvBatch);
+        m_rmsgs.resize(m_recvBatch);
+        for (size_t i = 0; i < m_recvBatch; i++) {
+            m_riovs[i].iov_base = m_rbuf.data() + i * UDP_RECV_BUFFER_LEN;
+            m_riovs[i].iov_len = UDP_RECV_BUFFER_LEN;
+            memset(&m_rmsgs[i], 0, sizeof(mmsghdr));
+            m_rmsgs[i].msg_hdr.msg_name = &m_raddrs[i];
+            m_rmsgs[i].msg_hdr.msg_iov = &m_riovs[i];
+            m_rmsgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    // The address (family, port and IP) as a map key
+    static std::string keyOf(const sockaddr* addr) {
+        if (addr->sa_family == AF_INET6) {
+            const sockaddr_in6* in6 = (const sockaddr_in6*) addr;
+            std::string key((const char*) &in6->sin6_port, sizeof(in6->sin6_port));
+            key.append((const char*) &in6->sin6_addr, sizeof(in6->sin6_addr));
+            return key;
+        }
+
+        const sockaddr_in* in = (const sockaddr_in*) addr;
+        std::string key((const char*) &in->sin_port, sizeof(in->sin_port));
+        key.append((const char*) &in->sin_addr, sizeof(in->sin_addr));
+        return key;
+    }
+
+    UdpPeer* getOrCreatePeer(const sockaddr* addr, socklen_t len) {
+        std::string key = keyOf(addr);
+        auto found = m_peers.find(key);
+        if (found != m_peers.end()) {
+            return found->second;
+        }
+
+        UdpPeer* peer = new UdpPeer(addr, len);
+        m_peers[key] = peer;
+        return peer;
+    }
+
+    // Moves the peer's current datagram into the send queue
+    void closeDatagram(UdpPeer* peer) {
+        size_t length = peer->m_pending.size();
+        if (length == 0) {
+            return;
+        }
+
+        Datagram datagram;
+        datagram.peer = peer;
+        datagram.offset = m_arena.size();
+        datagram.length = length;
+        m_arena.write(peer->m_pending.getBuffer(), 0, (uint16_t) length);
+        m_datagrams.push_back(datagram);
+        peer->m_pending.reset();
+    }
+
+    // Builds the messages for the datagrams from the given index onwards. Returns the number of messages
+    size_t buildMessages(size_t first) {
+        size_t remaining = m_datagrams.size() - first;
+        m_smsgs.resize(remaining);
+        m_siovs.resize(remaining);
+        m_msgFirst.resize(remaining);
+        m_msgSegments.resize(remaining);
+        m_control.resize(remaining * CMSG_SPACE(sizeof(uint16_t)));
+
+        uint8_t* arena = m_arena.getBuffer();
+        size_t count = 0;
+        size_t i = first;
+        while (i < m_datagrams.size()) {
+            Datagram& datagram = m_datagrams[i];
+            mmsghdr& msg = m_smsgs[count];
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_hdr.msg_name = (void*) datagram.peer->getAddress();
+            msg.msg_hdr.msg_namelen = datagram.peer->getAddressLength();
+            msg.msg_hdr.msg_iov = &m_siovs[i - first];
+
+            // a GSO run is datagrams to the same peer which are all the same size, except the last, which may be smaller
+            size_t run = 1;
+            size_t bytes = datagram.length;
+            if (m_gso) {
+                while ((i + run) < m_datagrams.size() && run < UDP_MAX_GSO_SEGMENTS) {
+                    Datagram& next = m_datagrams[i + run];
+                    if (next.peer != datagram.peer || next.length > datagram.length || (bytes + next.length) > UDP_MAX_GSO_BYTES) {
+                        break;
+                    }
+
+                    bytes += next.length;
+                    run++;
+                    if (next.length < datagram.length) {
+                        break;
+                    }
+                }
+            }
+
+            for (size_t j = 0; j < run; j++) {
+                m_siovs[i - first + j].iov_base = arena + m_datagrams[i + j].offset;
+                m_siovs[i - first + j].iov_len = m_datagrams[i + j].length;
+            }
+
+            msg.msg_hdr.msg_iovlen = run;
+            if (run > 1) {
+                char* control = m_control.data() + count * CMSG_SPACE(sizeof(uint16_t));
+                msg.msg_hdr.msg_control = control;
+                msg.msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                cmsghdr* cmsg = CMSG_FIRSTHDR(&msg.msg_hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t segment = (uint16_t) datagram.length;
+                memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+            }
+
+            m_msgFirst[count] = i;
+            m_msgSegments[count] = run;
+            count++;
+            i += run;
+        }
+
+        return count;
+    }
+
+    bool receiveBatch(asio::error_code& ec) {
+        int n;
+        while (true) {
+            for (size_t i = 0; i < m_recvBatch; i++) {
+                m_rmsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+            }
+
+            n = recvmmsg(m_fd, m_rmsgs.data(), (unsigned int) m_recvBatch, MSG_WAITFORONE, nullptr);
+            m_recvCalls++;
+            if (n >= 0) {
+                break;
+            }
+
+            if (errno != EINTR) {
+                ec = asio::error_code(errno, asio::system_category());
+                return false;
+            }
+        }
+
+        for (int i = 0; i < n; i++) {
+            mmsghdr& msg = m_rmsgs[i];
+            if (msg.msg_hdr.msg_flags & MSG_TRUNC) {
+                m_dropped++;
+                continue;
+            }
+
+            const sockaddr* addr = (const sockaddr*) msg.msg_hdr.msg_name;
+            UdpPeer* peer;
+            auto found = m_peers.find(keyOf(addr));
+            if (found != m_peers.end()) {
+                peer = found->second;
+            }
+            else if (m_acceptUnknown && m_peers.size() < m_maxPeers) {
+                peer = getOrCreatePeer(addr, msg.msg_hdr.msg_namelen);
+            }
+            else {
+                m_dropped++;
+                continue;
+            }
+
+            peer->m_datagramsReceived++;
+            decodeDatagram(peer, (const uint8_t*) m_riovs[i].iov_base, msg.msg_len);
+        }
+
+        return true;
+    }
+
+    void decodeDatagram(UdpPeer* peer, const uint8_t* buffer, size_t length) {
+        m_reader.reset(buffer, length);
+        DataInputStream in(&m_reader);
+        while (m_reader.getRemaining() != 0) {
+            // check the frame fits in what's left before letting readPacket (and the packet's readPayload) at it
+            Received received;
+            received.peer = peer;
+            received.packet = nullptr;
+            size_t pos = m_reader.getPosition();
+            size_t remaining = m_reader.getRemaining();
+            if (remaining < PACKET_HEADER_LEN) {
+                received.err = PACKET_ERRCODE::INVALID_PACKET_SZ;
+            }
+            else if (buffer[pos] != PREAMBLE_SEQ1 || buffer[pos + 1] != PREAMBLE_SEQ2 || buffer[pos + 2] != PREAMBLE_SEQ3 || buffer[pos + 3] != PREAMBLE_SEQ4) {
+                // frames are always sent with the full preamble, so the shortened ones readPacket accepts are rejected too
+                received.err = Packet::readProtocolHeader(&in);
+                if (received.err & PROTOCOL_SUC_MASK) {
+                    received.err = PROTOCOL_ERRCODE::PROTOCOL_ERR_FFF0;
+                }
+            }
+            else if ((size_t)((buffer[pos + 5] << 8) | buffer[pos + 6]) > (remaining - PACKET_HEADER_LEN)) {
+                received.err = PACKET_ERRCODE::INVALID_PACKET_SZ;
+            }
+            else {
+                try {
+                    received.packet = Packet::readPacket(&in, received.err);
+                }
+                catch (asio::system_error&) {
+                    // the packet read past the end of the datagram; readPacket has already deleted it
+                    received.err = PACKET_ERRCODE::INVALID_PACKET_SZ;
+                }
+            }
+
+            if (received.packet == nullptr) {
+                // the frames can't be trusted to line up after this, so the rest of the datagram is dropped
+                peer->m_decodeErrors++;
+                m_received.push_back(received);
+                return;
+            }
+
+            peer->m_packetsReceived++;
+            m_received.push_back(received);
+        }
+    }
+
+    int m_fd;
+    sa_family_t m_family;
+    uint16_t m_maxDatagram;
+    bool m_gso;
+    bool m_acceptUnknown;
+    size_t m_maxPeers;
+    std::unordered_map<std::string, UdpPeer*> m_peers;
+
+    // sending
+    std::vector<UdpPeer*> m_openPeers;
+    ByteArrayOutStream m_arena;
+    std::vector<Datagram> m_datagrams;
+    std::vector<mmsghdr> m_smsgs;
+    std::vector<iovec> m_siovs;
+    std::vector<size_t> m_msgFirst;
+    std::vector<size_t> m_msgSegments;
+    std::vector<char> m_control;
+    uint64_t m_sendCalls;
+
+    // receiving
+    size_t m_recvBatch;
+    std::vector<uint8_t> m_rbuf;
+    std::vector<sockaddr_storage> m_raddrs;
+    std::vector<iovec> m_riovs;
+    std::vector<mmsghdr> m_rmsgs;
+    ByteArrayInStream m_reader;
+    std::deque<Received> m_received;
+    uint64_t m_recvCalls;
+    uint64_t m_dropped;
+};
+
+#endif // !__IMPL_UDPTRANSPORT
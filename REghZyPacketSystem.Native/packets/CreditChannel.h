@@ -0,0 +1,279 @@
+#ifndef __IMPL_CREDITCHANNEL
+#define __IMPL_CREDITCHANNEL
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "Packet.h"
+#include "PacketCreditGrant.h"
+#include "../data/ByteArrayOutStream.h"
+
+// What the sender does when it doesn't have enough credits to send a packet
+enum CREDIT_POLICY : uint8_t {
+    CREDIT_POLICY_BLOCK = 0, // Wait (up to the block timeout) for the peer to grant more credits
+    CREDIT_POLICY_QUEUE = 1, // Encode the packet and queue it; it's sent as soon as enough credits are granted
+    CREDIT_POLICY_DROP  = 2  // Discard the packet
+};
+
+#define CREDIT_ERRCODE_MASK 0b00010000 // A bitmask used for checking if a send result came from the credit channel
+enum CREDIT_ERRCODE : uint8_t {
+    CREDIT_SEND_SUCCESS = 0b00000000, // The packet was written
+    CREDIT_SEND_QUEUED  = 0b00010001, // The packet was queued, and will be written once enough credits are granted
+    CREDIT_SEND_DROPPED = 0b00010010, // The packet was dropped, because there weren't enough credits
+    CREDIT_SEND_TIMEOUT = 0b00010011, // No credits were granted within the block timeout; the packet wasn't sent
+    CREDIT_QUEUE_FULL   = 0b00010100, // The send queue has no room for the packet; the packet wasn't sent
+    CREDIT_PACKET_SIZE  = 0b00010101, // The packet is bigger than the send window could ever be; it can never be sent
+};
+
+// Opt-in credit based flow control on top of a DataStream
+//
+// Each side grants the other a receive window (in bytes and packets). The sender spends
+// credits for every packet it writes (PACKET_HEADER_LEN + the payload size, and 1 frame),
+// and once it runs out, it blocks, queues or drops according to its policy. The receiver
+// hands credits back as the application releases packets that it has finished with,
+// so the number of packets received but not yet processed never exceeds the window
+//
+// Credits are granted with PacketCreditGrant (PACKET_ID_CREDIT_GRANT), which readPacket
+// consumes itself, so it must be registered with REGISTER_PACKET on both sides
+//
+// send and release may be called from a different thread to readPacket, but blocking
+// sends will only ever be woken up by readPacket, so don't block on the reading thread
+class CreditChannel {
+public:
+    // windowBytes and windowFrames are how much this side is willing to receive before the
+    // application releases anything. maxQueuedBytes is only used by CREDIT_POLICY_QUEUE
+    CreditChannel(DataStream* stream, uint32_t windowBytes, uint16_t windowFrames, uint8_t policy, uint32_t maxQueuedBytes) {
+        m_out = stream->getOutput();
+        m_in = stream->getInput();
+        m_policy = policy;
+        m_blockTimeout = std::chrono::milliseconds(1000);
+        m_maxQueuedBytes = maxQueuedBytes;
+        m_queuedBytes = 0;
+        m_sendBytes = 0;
+        m_sendFrames = 0;
+        m_maxSendBytes = 0;
+        m_windowBytes = windowBytes;
+        m_windowFrames = windowFrames;
+        m_recvBytes = 0;
+        m_recvFrames = 0;
+        m_drainedBytes = 0;
+        m_drainedFrames = 0;
+        m_dropped = 0;
+        m_overruns = 0;
+    }
+
+public:
+    // Grants the peer the entire receive window. Both sides must call this once, before anything is sent
+    uint8_t open() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_recvBytes = m_windowBytes;
+        m_recvFrames = m_windowFrames;
+        PacketCreditGrant grant(m_windowBytes, m_windowFrames);
+        return Packet::writePacket(m_out, &grant);
+    }
+
+    // Sends the given packet if there are enough credits, otherwise applies the policy.
+    // The caller keeps ownership of the packet, even if it gets queued
+    uint8_t send(Packet* packet) {
+        uint32_t cost = PACKET_HEADER_LEN + packet->getPayloadSize();
+        std::unique_lock<std::mutex> lock(m_lock);
+        if (m_queue.empty() && canSpend(cost)) {
+            spend(cost);
+            return Packet::writePacket(m_out, packet);
+        }
+
+        if (m_maxSendBytes && cost > m_maxSendBytes) {
+            return CREDIT_PACKET_SIZE;
+        }
+
+        switch (m_policy) {
+            case CREDIT_POLICY_BLOCK: {
+                auto ready = [&]() { return m_queue.empty() && canSpend(cost); };
+                if (m_blockTimeout.count() == 0) {
+                    m_granted.wait(lock, ready);
+                }
+                else if (!m_granted.wait_for(lock, m_blockTimeout, ready)) {
+                    return CREDIT_SEND_TIMEOUT;
+                }
+
+                spend(cost);
+                return Packet::writePacket(m_out, packet);
+            }
+            case CREDIT_POLICY_QUEUE: {
+                if ((m_queuedBytes + cost) > m_maxQueuedBytes) {
+                    return CREDIT_QUEUE_FULL;
+                }
+
+                ByteArrayOutStream buffer(cost);
+                DataOutputStream out(&buffer);
+                uint8_t err = Packet::writePacket(&out, packet);
+                if (err) {
+                    return err;
+                }
+
+                m_queue.push_back(buffer.release());
+                m_queuedBytes += cost;
+                return CREDIT_SEND_QUEUED;
+            }
+            default: {
+                m_dropped++;
+                return CREDIT_SEND_DROPPED;
+            }
+        }
+    }
+
+    // Reads the next packet that the application should handle. Credit grants are consumed here,
+    // and packets that the peer sent without having the credits for are discarded (see getOverrunCount)
+    Packet* readPacket(uint16_t& err) {
+        while (true) {
+            Packet* packet = Packet::readPacket(m_in, err);
+            if (packet == nullptr) {
+                return nullptr;
+            }
+
+            if (packet->getId() == PACKET_ID_CREDIT_GRANT) {
+                PacketCreditGrant* grant = (PacketCreditGrant*)packet;
+                onGrant(grant->getBytes(), grant->getFrames());
+                delete(grant);
+                continue;
+            }
+
+            uint32_t cost = PACKET_HEADER_LEN + packet->getPayloadSize();
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (cost > m_recvBytes || m_recvFrames == 0) {
+                m_overruns++;
+                delete(packet);
+                continue;
+            }
+
+            m_recvBytes -= cost;
+            m_recvFrames--;
+            return packet;
+        }
+    }
+
+    // Tells the channel that the application has finished with a packet returned by readPacket, which
+    // frees up its space in the receive window. This doesn't delete the packet. The credits are handed
+    // back to the peer in batches, once half of the window (either bytes or frames) has been released
+    uint8_t release(Packet* packet) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_drainedBytes += PACKET_HEADER_LEN + packet->getPayloadSize();
+        m_drainedFrames++;
+        if (m_drainedBytes < (m_windowBytes / 2) && m_drainedFrames < ((m_windowFrames + 1) / 2)) {
+            return PKT_WRITE_SUCCESS;
+        }
+
+        PacketCreditGrant grant(m_drainedBytes, (uint16_t)m_drainedFrames);
+        m_recvBytes += m_drainedBytes;
+        m_recvFrames += m_drainedFrames;
+        m_drainedBytes = 0;
+        m_drainedFrames = 0;
+        return Packet::writePacket(m_out, &grant);
+    }
+
+    // How long a blocking send waits for credits. 0 means wait forever
+    void setBlockTimeout(std::chrono::milliseconds timeout) {
+        m_blockTimeout = timeout;
+    }
+
+    void setPolicy(uint8_t policy) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_policy = policy;
+    }
+
+    // The number of bytes that can currently be sent without waiting
+    uint32_t getSendBytesCredit() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_sendBytes;
+    }
+
+    // The number of packets that can currently be sent without waiting
+    uint32_t getSendFramesCredit() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_sendFrames;
+    }
+
+    // The number of encoded bytes waiting in the send queue
+    uint32_t getQueuedBytes() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_queuedBytes;
+    }
+
+    // The number of packets dropped by CREDIT_POLICY_DROP
+    uint64_t getDroppedCount() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_dropped;
+    }
+
+    // The number of received packets discarded because the peer had no credits to send them
+    uint64_t getOverrunCount() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_overruns;
+    }
+
+private:
+    bool canSpend(uint32_t cost) {
+        return cost <= m_sendBytes && m_sendFrames > 0;
+    }
+
+    void spend(uint32_t cost) {
+        m_sendBytes -= cost;
+        m_sendFrames--;
+    }
+
+    void onGrant(uint32_t bytes, uint16_t frames) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_sendBytes += bytes;
+        m_sendFrames += frames;
+
+        // the first grant is the peer's entire window, so nothing bigger than that can ever be sent
+        if (m_maxSendBytes == 0) {
+            m_maxSendBytes = bytes;
+        }
+
+        while (!m_queue.empty()) {
+            std::vector<uint8_t>& frame = m_queue.front();
+            uint32_t cost = (uint32_t)frame.size();
+            if (!canSpend(cost)) {
+                break;
+            }
+
+            spend(cost);
+            m_out->write(frame.data(), 0, (uint16_t)cost);
+            m_out->flush();
+            m_queuedBytes -= cost;
+            m_queue.pop_front();
+        }
+
+        m_granted.notify_all();
+    }
+
+    DataOutputStream* m_out;
+    DataInputStream* m_in;
+    std::mutex m_lock;
+    std::condition_variable m_granted;
+    std::chrono::milliseconds m_blockTimeout;
+    uint8_t m_policy;
+
+    // sending side
+    std::deque<std::vector<uint8_t>> m_queue;
+    uint32_t m_maxQueuedBytes;
+    uint32_t m_queuedBytes;
+    uint32_t m_sendBytes;
+    uint32_t m_sendFrames;
+    uint32_t m_maxSendBytes;
+    uint64_t m_dropped;
+
+    // receiving side
+    uint32_t m_windowBytes;
+    uint32_t m_windowFrames;
+    uint32_t m_recvBytes;
+    uint32_t m_recvFrames;
+    uint32_t m_drainedBytes;
+    uint32_t m_drainedFrames;
+    uint64_t m_overruns;
+};
+
+#endif // !__IMPL_CREDITCHANNEL
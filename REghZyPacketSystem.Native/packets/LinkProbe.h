@@ -0,0 +1,434 @@
+#ifndef __IMPL_LINKPROBE
+#define __IMPL_LINKPROBE
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "Packet.h"
+#include "PacketProbe.h"
+
+#define LINK_PROBE_HISTORY 8        // the number of samples the clock offset and peak delivery rate are picked from
+#define LINK_PROBE_OUTSTANDING 16   // the number of probes that can be waiting for a reply
+#define LINK_DEFAULT_INITIAL_RTO 1000000 // 1 second, before there are any samples (as RFC 6298 does)
+#define LINK_DEFAULT_MIN_RTO 10000       // 10 milliseconds
+#define LINK_DEFAULT_MAX_RTO 60000000    // 60 seconds
+
+// A snapshot of everything a LinkEstimator knows. Times are in microseconds, rates in bytes per second
+struct LinkEstimate {
+    int64_t srtt;
+    int64_t rttVar;
+    int64_t rto;
+    int64_t latestRtt;
+    int64_t minRtt;
+    int64_t clockOffset;
+    double deliveryRate;
+    double peakDeliveryRate;
+    uint64_t samples;
+    uint64_t lost;
+};
+
+// Turns probe results into live link estimates, which are safe to read from any thread
+//
+// The RTT is smoothed the way TCP does it (RFC 6298): SRTT and RTTVAR are moving averages with gains
+// of 1/8 and 1/4, and the retransmission timeout is SRTT + 4 * RTTVAR, clamped to [min RTO, max RTO].
+// A probe that goes unanswered doubles the RTO until the next sample arrives
+//
+// The clock offset (the peer's wall clock minus ours) is the one measured by the probe with the lowest
+// RTT out of the last few, since that probe spent the least time queued, and queueing is rarely symmetric
+class LinkEstimator {
+public:
+    LinkEstimator() {
+        m_minRto = LINK_DEFAULT_MIN_RTO;
+        m_maxRto = LINK_DEFAULT_MAX_RTO;
+        reset();
+    }
+
+public:
+    // Forgets every sample, e.g. after reconnecting
+    void reset() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_srtt = 0;
+        m_rttVar = 0;
+        m_rto = LINK_DEFAULT_INITIAL_RTO;
+        m_latestRtt = 0;
+        m_minRtt = 0;
+        m_clockOffset = 0;
+        m_deliveryRate = 0;
+        m_samples = 0;
+        m_lost = 0;
+        m_rateSamples = 0;
+        for (int i = 0; i < LINK_PROBE_HISTORY; i++) {
+            m_history[i].rtt = -1;
+            m_history[i].offset = 0;
+            m_rates[i] = 0;
+        }
+    }
+
+    // Adds a round trip (with the peer's processing time already taken out) and the clock offset it measured
+    void onSample(int64_t rtt, int64_t offset) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_samples == 0) {
+            m_srtt = rtt;
+            m_rttVar = rtt / 2;
+            m_minRtt = rtt;
+        }
+        else {
+            int64_t delta = m_srtt > rtt ? m_srtt - rtt : rtt - m_srtt;
+            m_rttVar = (3 * m_rttVar + delta) / 4;
+            m_srtt = (7 * m_srtt + rtt) / 8;
+            if (rtt < m_minRtt) {
+                m_minRtt = rtt;
+            }
+        }
+
+        m_latestRtt = rtt;
+        m_rto = clampRto(m_srtt + (m_rttVar * 4 > 1 ? m_rttVar * 4 : 1));
+
+        Sample& slot = m_history[m_samples % LINK_PROBE_HISTORY];
+        slot.rtt = rtt;
+        slot.offset = offset;
+        m_samples++;
+        int best = 0;
+        for (int i = 1; i < LINK_PROBE_HISTORY; i++) {
+            if (m_history[i].rtt >= 0 && (m_history[best].rtt < 0 || m_history[i].rtt < m_history[best].rtt)) {
+                best = i;
+            }
+        }
+
+        m_clockOffset = m_history[best].offset;
+    }
+
+    // Adds a delivery rate measurement: the peer received the given number of bytes over the given time
+    void onDelivered(uint64_t bytes, int64_t micros) {
+        if (micros <= 0) {
+            return;
+        }
+
+        double rate = (double) bytes * 1000000.0 / (double) micros;
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_deliveryRate = m_rateSamples == 0 ? rate : m_deliveryRate + (rate - m_deliveryRate) / 4;
+        m_rates[m_rateSamples % LINK_PROBE_HISTORY] = rate;
+        m_rateSamples++;
+    }
+
+    // A probe wasn't answered within the RTO, so back off (RFC 6298, 5.5)
+    void onTimeout() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_lost++;
+        m_rto = clampRto(m_rto * 2);
+    }
+
+    // The range the RTO is kept within, in microseconds
+    void setRtoBounds(int64_t minRto, int64_t maxRto) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_minRto = minRto;
+        m_maxRto = maxRto < minRto ? minRto : maxRto;
+        m_rto = clampRto(m_rto);
+    }
+
+    // Whether at least one RTT sample has arrived. Until then, the RTO is 1 second and everything else is 0
+    bool hasSample() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_samples != 0;
+    }
+
+    int64_t getSrtt() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_srtt;
+    }
+
+    int64_t getRttVar() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_rttVar;
+    }
+
+    // How long to wait for a response before resending a request, in microseconds
+    int64_t getRto() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_rto;
+    }
+
+    int64_t getMinRtt() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_minRtt;
+    }
+
+    // The peer's wall clock minus ours, in microseconds. Add this to a local time to get the peer's time
+    int64_t getClockOffset() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_clockOffset;
+    }
+
+    // The smoothed rate the peer has been receiving our bytes at, in bytes per second. This is what the link
+    // has been carrying, so it only reaches the link's capacity while the link is kept busy
+    double getDeliveryRate() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_deliveryRate;
+    }
+
+    // The highest delivery rate out of the last few samples, which is the closest estimate of the link's capacity
+    double getPeakDeliveryRate() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return peakRate();
+    }
+
+    // The number of bytes that fit in the link over one round trip (peak delivery rate * SRTT), which
+    // is a sensible size for a batch; anything bigger just queues, and anything smaller leaves the link idle
+    uint64_t getBandwidthDelayProduct() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return (uint64_t) (peakRate() * (double) m_srtt / 1000000.0);
+    }
+
+    LinkEstimate getEstimate() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        LinkEstimate estimate;
+        estimate.srtt = m_srtt;
+        estimate.rttVar = m_rttVar;
+        estimate.rto = m_rto;
+        estimate.latestRtt = m_latestRtt;
+        estimate.minRtt = m_minRtt;
+        estimate.clockOffset = m_clockOffset;
+        estimate.deliveryRate = m_deliveryRate;
+        estimate.peakDeliveryRate = peakRate();
+        estimate.samples = m_samples;
+        estimate.lost = m_lost;
+        return estimate;
+    }
+
+private:
+    struct Sample {
+        int64_t rtt; // -1 when empty
+        int64_t offset;
+    };
+
+    int64_t clampRto(int64_t rto) {
+        return rto < m_minRto ? m_minRto : (rto > m_maxRto ? m_maxRto : rto);
+    }
+
+    double peakRate() {
+        double peak = 0;
+        for (int i = 0; i < LINK_PROBE_HISTORY; i++) {
+            if (m_rates[i] > peak) {
+                peak = m_rates[i];
+            }
+        }
+
+        return peak;
+    }
+
+    std::mutex m_lock;
+    int64_t m_minRto;
+    int64_t m_maxRto;
+    int64_t m_srtt;
+    int64_t m_rttVar;
+    int64_t m_rto;
+    int64_t m_latestRtt;
+    int64_t m_minRtt;
+    int64_t m_clockOffset;
+    double m_deliveryRate;
+    uint64_t m_samples;
+    uint64_t m_lost;
+    uint64_t m_rateSamples;
+    Sample m_history[LINK_PROBE_HISTORY];
+    double m_rates[LINK_PROBE_HISTORY];
+};
+
+// Measures a link with PacketProbe and PacketProbeReply, on top of a DataStream
+//
+// readPacket answers probes and consumes replies itself, so the application only sees its own packets.
+// Call poll regularly (e.g. from the sending loop) and it sends a probe every probe interval, and
+// notices probes that were never answered. Both sides must wrap their stream in a LinkProbe (or at least
+// answer probes), and both packets must be registered with REGISTER_PACKET
+//
+// Everything this side sends should go through writePacket, since probes and replies are written from
+// whichever thread calls poll and readPacket. The estimates are kept in getEstimator, which any thread may read
+class LinkProbe {
+public:
+    LinkProbe(DataStream* stream, std::chrono::milliseconds interval) {
+        m_out = stream->getOutput();
+        m_in = stream->getInput();
+        m_interval = interval;
+        m_nextSeq = 0;
+        m_lastProbe = 0;
+        m_bytesSent = 0;
+        m_bytesReceived = 0;
+        m_lastReceive = 0;
+        m_lastReceived = 0;
+        m_hasLastReply = false;
+        for (int i = 0; i < LINK_PROBE_OUTSTANDING; i++) {
+            m_outstanding[i].sent = 0;
+        }
+    }
+
+public:
+    uint8_t writePacket(Packet* packet) {
+        std::lock_guard<std::mutex> lock(m_writeLock);
+        uint8_t err = Packet::writePacket(m_out, packet);
+        if (!err) {
+            m_bytesSent += PACKET_HEADER_LEN + packet->getPayloadSize();
+        }
+
+        return err;
+    }
+
+    // Reads the next packet that the application should handle, answering or consuming any probe packets before it
+    Packet* readPacket(uint16_t& err) {
+        while (true) {
+            Packet* packet = Packet::readPacket(m_in, err);
+            if (packet == nullptr) {
+                return nullptr;
+            }
+
+            uint64_t received = m_bytesReceived.fetch_add(PACKET_HEADER_LEN + packet->getPayloadSize()) + PACKET_HEADER_LEN + packet->getPayloadSize();
+            uint8_t id = packet->getId();
+            if (id == PACKET_ID_PROBE) {
+                int64_t receive = wallMicros();
+                PacketProbe* probe = (PacketProbe*) packet;
+                PacketProbeReply reply(probe->getSeq(), probe->getOrigin(), receive, wallMicros(), received);
+                delete(probe);
+                uint8_t writeErr = writePacket(&reply);
+                if (writeErr) {
+                    err = writeErr;
+                    return nullptr;
+                }
+
+                continue;
+            }
+            else if (id == PACKET_ID_PROBE_REPLY) {
+                onReply((PacketProbeReply*) packet);
+                delete(packet);
+                continue;
+            }
+
+            return packet;
+        }
+    }
+
+    // Sends a probe now, regardless of the interval
+    uint8_t probe() {
+        uint32_t seq;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            seq = m_nextSeq++;
+            m_lastProbe = monoMicros();
+            Outstanding& slot = m_outstanding[seq % LINK_PROBE_OUTSTANDING];
+            if (slot.sent != 0) {
+                m_estimator.onTimeout(); // so many probes went unanswered that this one's slot is being reused
+            }
+
+            slot.seq = seq;
+            slot.sent = m_lastProbe;
+        }
+
+        PacketProbe probe(seq, wallMicros());
+        return writePacket(&probe);
+    }
+
+    // Counts probes that weren't answered within the RTO as lost, and sends a probe if the interval has passed
+    uint8_t poll() {
+        int64_t now = monoMicros();
+        int64_t rto = m_estimator.getRto();
+        bool due;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (int i = 0; i < LINK_PROBE_OUTSTANDING; i++) {
+                if (m_outstanding[i].sent != 0 && (now - m_outstanding[i].sent) > rto) {
+                    m_outstanding[i].sent = 0;
+                    m_estimator.onTimeout();
+                }
+            }
+
+            due = m_lastProbe == 0 || (now - m_lastProbe) >= (int64_t) std::chrono::duration_cast<std::chrono::microseconds>(m_interval).count();
+        }
+
+        return due ? probe() : (uint8_t) PKT_WRITE_SUCCESS;
+    }
+
+    void setInterval(std::chrono::milliseconds interval) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_interval = interval;
+    }
+
+    LinkEstimator& getEstimator() {
+        return m_estimator;
+    }
+
+    // The number of bytes (headers included) written with writePacket, probes and replies included
+    uint64_t getBytesSent() {
+        std::lock_guard<std::mutex> lock(m_writeLock);
+        return m_bytesSent;
+    }
+
+    // The number of bytes (headers included) read with readPacket, probes and replies included
+    uint64_t getBytesReceived() {
+        return m_bytesReceived.load();
+    }
+
+    // Microseconds since the unix epoch, which is the clock that probe times are in
+    static int64_t wallMicros() {
+        return (int64_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    struct Outstanding {
+        uint32_t seq;
+        int64_t sent; // the monotonic time it was sent, or 0 if it isn't waiting for a reply
+    };
+
+    static int64_t monoMicros() {
+        // never 0, since that marks an empty slot
+        return (int64_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() + 1;
+    }
+
+    void onReply(PacketProbeReply* reply) {
+        int64_t now = monoMicros();
+        int64_t wallNow = wallMicros();
+        int64_t sent;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            Outstanding& slot = m_outstanding[reply->getSeq() % LINK_PROBE_OUTSTANDING];
+            if (slot.sent == 0 || slot.seq != reply->getSeq()) {
+                return; // a late reply to a probe that was already counted as lost
+            }
+
+            sent = slot.sent;
+            slot.sent = 0;
+        }
+
+        // the RTT uses our monotonic clock, so a wall clock step can't ruin it. Only the offset uses the wall clocks
+        int64_t held = reply->getTransmit() - reply->getReceive();
+        int64_t rtt = (now - sent) - (held > 0 ? held : 0);
+        int64_t offset = ((reply->getReceive() - reply->getOrigin()) + (reply->getTransmit() - wallNow)) / 2;
+        m_estimator.onSample(rtt > 0 ? rtt : 0, offset);
+
+        // both ends of the delivery rate come from the peer's clock
+        if (m_hasLastReply && reply->getReceived() > m_lastReceived) {
+            m_estimator.onDelivered(reply->getReceived() - m_lastReceived, reply->getReceive() - m_lastReceive);
+        }
+
+        m_lastReceive = reply->getReceive();
+        m_lastReceived = reply->getReceived();
+        m_hasLastReply = true;
+    }
+
+    DataOutputStream* m_out;
+    DataInputStream* m_in;
+    LinkEstimator m_estimator;
+    std::mutex m_writeLock;
+    std::mutex m_lock;
+    std::chrono::milliseconds m_interval;
+
+    // sending side
+    uint32_t m_nextSeq;
+    int64_t m_lastProbe;
+    uint64_t m_bytesSent;
+    Outstanding m_outstanding[LINK_PROBE_OUTSTANDING];
+
+    // receiving side (only touched by readPacket)
+    std::atomic<uint64_t> m_bytesReceived;
+    int64_t m_lastReceive;
+    uint64_t m_lastReceived;
+    bool m_hasLastReply;
+};
+
+#endif // !__IMPL_LINKPROBE
@@ -4,6 +4,15 @@
 #include "../data/DataStream.h"
 
 #define MAX_PAYLOAD_LEN 1017
+#define PACKET_HEADER_LEN 7 // 4 preamble bytes, 1 byte ID, 2 byte payload length
+
+// IDs reserved for the packet system's own control packets. These are allocated
+// downwards from the top of the ID range, so user packets should use IDs below PACKET_ID_RESERVED_MIN
+#define PACKET_ID_RESERVED_MIN 240
+#define PACKET_ID_CREDIT_GRANT 254 // PacketCreditGrant; see CreditChannel
+#define PACKET_ID_CONTAINER 253 // PacketContainer; see ContainerWriter and ContainerReader
+#define PACKET_ID_PROBE 252 // PacketProbe; see LinkProbe
+#define PACKET_ID_PROBE_REPLY 251 // PacketProbeReply; see LinkProbe
 
 #define PREAMBLE_SEQ1 0b01110010 // 'r'
 #define PREAMBLE_SEQ2 0b01111010 // 'z'
@@ -53,6 +62,8 @@ public:
 
     }
 
+    virtual ~Packet() { }
+
 public:
     virtual uint8_t getId() { return 0; }
 
@@ -118,9 +129,19 @@ public:
             }
 
             Packet* packet = ctor();
-            int8_t readErr = packet->readPayload(in, len);
+            int8_t readErr;
+            try {
+                readErr = packet->readPayload(in, len);
+            }
+            catch (...) {
+                // e.g. the stream ran out part way through the payload; the caller may retry once more data arrives
+                delete(packet);
+                throw;
+            }
+
             if (readErr) {
                 err = UTIL_COMB_PKR_ERROR(readErr);
+                delete(packet);
                 return nullptr;
             }
 
@@ -132,7 +153,8 @@ public:
         }
     }
 
-private:
+    // Reads the 4 preamble bytes, returning one of PROTOCOL_ERRCODE. Exposed for readers
+    // that decode the rest of the frame themselves (e.g. SecureChannel)
     static uint16_t readProtocolHeader(DataInputStream* in) {
         uint8_t seq1 = in->readByte();
         if (seq1 == PREAMBLE_SEQ1) {
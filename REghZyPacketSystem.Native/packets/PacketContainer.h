@@ -0,0 +1,280 @@
+#ifndef __IMPL_PACKETCONTAINER
+#define __IMPL_PACKETCONTAINER
+
+#include <deque>
+#include <vector>
+#include "Packet.h"
+#include "../data/ByteArrayInStream.h"
+#include "../data/ByteArrayOutStream.h"
+
+#define CONTAINER_SUB_HEADER_LEN 2   // 1 byte ID, 1 byte payload length
+#define CONTAINER_MAX_SUB_PAYLOAD 255
+
+// A packet that carries many small packets under a single packet header, so that
+// packets with tiny payloads don't spend most of the bandwidth on headers
+//
+// [ Sub packet ] [ Sub packet ] ...
+// [ ID ] [ Length ] [ Payload ]
+// [ 1b ] [   1b   ] [ Len-b   ]
+//
+// Use ContainerWriter to build these, and ContainerReader to unpack them. The receiving
+// side must register it with REGISTER_PACKET(PACKET_ID_CONTAINER, new PacketContainer())
+class PacketContainer : public Packet {
+public:
+    PacketContainer() {
+        m_errors = 0;
+    }
+
+    ~PacketContainer() {
+        for (Packet* packet : m_packets) {
+            delete(packet);
+        }
+    }
+
+public:
+    uint8_t getId() override { return PACKET_ID_CONTAINER; }
+
+    uint16_t getPayloadSize() override {
+        return (uint16_t)m_payload.size();
+    }
+
+    // Decodes every sub packet with ctor_table. A sub packet that can't be decoded (unknown ID, or
+    // a payload read error) is skipped and counted in getErrorCount, but the rest are still delivered
+    uint8_t readPayload(DataInputStream* in, uint16_t len) override {
+        m_payload.resize(len);
+        in->readFully(m_payload.data(), 0, len);
+
+        size_t pos = 0;
+        while (pos < len) {
+            if ((pos + CONTAINER_SUB_HEADER_LEN) > len) {
+                return INVALID_PACKET_SZ;
+            }
+
+            uint8_t id = m_payload[pos];
+            uint8_t sublen = m_payload[pos + 1];
+            pos += CONTAINER_SUB_HEADER_LEN;
+            if ((pos + sublen) > len) {
+                return INVALID_PACKET_SZ;
+            }
+
+            pkt_ctor ctor = id == PACKET_ID_CONTAINER ? nullptr : ctor_table[id];
+            if (ctor == nullptr) {
+                m_errors++;
+                pos += sublen;
+                continue;
+            }
+
+            ByteArrayInStream sub(m_payload.data() + pos, sublen);
+            DataInputStream subin(&sub);
+            Packet* packet = ctor();
+            uint8_t err;
+            try {
+                err = packet->readPayload(&subin, sublen);
+            }
+            catch (asio::system_error&) {
+                err = INVALID_PACKET_SZ; // the sub packet tried to read past its own payload
+            }
+
+            if (err) {
+                m_errors++;
+                delete(packet);
+            }
+            else {
+                m_packets.push_back(packet);
+            }
+
+            pos += sublen;
+        }
+
+        return CTOR_READ_SUCCESS;
+    }
+
+    uint8_t writePayload(DataOutputStream* out) override {
+        out->write(m_payload.data(), 0, (uint16_t)m_payload.size());
+        return PKT_WRITE_SUCCESS;
+    }
+
+    // Moves the decoded sub packets out of this container. The caller now owns them
+    std::vector<Packet*> takePackets() {
+        std::vector<Packet*> packets;
+        packets.swap(m_packets);
+        return packets;
+    }
+
+    // The number of sub packets that couldn't be decoded
+    uint16_t getErrorCount() {
+        return m_errors;
+    }
+
+private:
+    friend class ContainerWriter;
+
+    std::vector<uint8_t> m_payload;
+    std::vector<Packet*> m_packets;
+    uint16_t m_errors;
+};
+
+// Packs whatever packets are sent to it into PacketContainers. Packets accumulate until flush is
+// called or the container is full, so the caller should flush once its own send queue is empty
+//
+// Packets with a payload bigger than CONTAINER_MAX_SUB_PAYLOAD are written on their own (after
+// flushing, to keep the order), and a container holding a single packet is written as that packet
+class ContainerWriter {
+public:
+    ContainerWriter(DataOutputStream* out) {
+        m_out = out;
+        m_count = 0;
+        m_lastId = 0;
+        m_payload = new DataOutputStream(&m_buffer);
+    }
+
+    ~ContainerWriter() {
+        delete(m_payload);
+    }
+
+public:
+    // Adds the packet to the current container. The packet is encoded immediately, so the caller keeps ownership
+    uint8_t send(Packet* packet) {
+        uint16_t size = packet->getPayloadSize();
+        if (size > CONTAINER_MAX_SUB_PAYLOAD) {
+            uint8_t err = flush();
+            if (err) {
+                return err;
+            }
+
+            return Packet::writePacket(m_out, packet);
+        }
+
+        if ((m_container.m_payload.size() + CONTAINER_SUB_HEADER_LEN + size) > MAX_PAYLOAD_LEN) {
+            uint8_t err = flush();
+            if (err) {
+                return err;
+            }
+        }
+
+        m_buffer.reset();
+        uint8_t err = packet->writePayload(m_payload);
+        if (err) {
+            return err;
+        }
+
+        if (m_buffer.size() != size) {
+            return INVALID_PACKET_SZ; // getPayloadSize didn't match what writePayload wrote
+        }
+
+        std::vector<uint8_t>& payload = m_container.m_payload;
+        payload.push_back(packet->getId());
+        payload.push_back((uint8_t)size);
+        payload.insert(payload.end(), m_buffer.getBuffer(), m_buffer.getBuffer() + size);
+        m_lastId = packet->getId();
+        m_count++;
+        return PKT_WRITE_SUCCESS;
+    }
+
+    // Writes the current container (if there is one) and flushes the output stream
+    uint8_t flush() {
+        if (m_count == 0) {
+            return PKT_WRITE_SUCCESS;
+        }
+
+        std::vector<uint8_t>& payload = m_container.m_payload;
+        uint8_t err;
+        if (m_count == 1) {
+            EncodedPacket single(m_lastId, payload.data() + CONTAINER_SUB_HEADER_LEN, (uint16_t)(payload.size() - CONTAINER_SUB_HEADER_LEN));
+            err = Packet::writePacket(m_out, &single);
+        }
+        else {
+            err = Packet::writePacket(m_out, &m_container);
+        }
+
+        payload.clear();
+        m_count = 0;
+        return err;
+    }
+
+    // The number of packets waiting in the current container
+    uint16_t getPendingCount() {
+        return m_count;
+    }
+
+private:
+    // A packet whose payload has already been encoded, so it can be written with Packet::writePacket
+    class EncodedPacket : public Packet {
+    public:
+        EncodedPacket(uint8_t id, uint8_t* payload, uint16_t size) {
+            m_id = id;
+            m_data = payload;
+            m_size = size;
+        }
+
+        uint8_t getId() override { return m_id; }
+
+        uint16_t getPayloadSize() override { return m_size; }
+
+        uint8_t writePayload(DataOutputStream* out) override {
+            out->write(m_data, 0, m_size);
+            return PKT_WRITE_SUCCESS;
+        }
+
+    private:
+        uint8_t m_id;
+        uint8_t* m_data;
+        uint16_t m_size;
+    };
+
+    DataOutputStream* m_out;
+    ByteArrayOutStream m_buffer;
+    DataOutputStream* m_payload;
+    PacketContainer m_container;
+    uint16_t m_count;
+    uint8_t m_lastId;
+};
+
+// Reads packets like Packet::readPacket, but unpacks PacketContainers and returns
+// their sub packets one at a time, so the caller never sees the containers
+class ContainerReader {
+public:
+    ContainerReader(DataInputStream* in) {
+        m_in = in;
+        m_errors = 0;
+    }
+
+    ~ContainerReader() {
+        for (Packet* packet : m_pending) {
+            delete(packet);
+        }
+    }
+
+public:
+    Packet* readPacket(uint16_t& err) {
+        while (m_pending.empty()) {
+            Packet* packet = Packet::readPacket(m_in, err);
+            if (packet == nullptr || packet->getId() != PACKET_ID_CONTAINER) {
+                return packet;
+            }
+
+            PacketContainer* container = (PacketContainer*)packet;
+            std::vector<Packet*> packets = container->takePackets();
+            m_pending.insert(m_pending.end(), packets.begin(), packets.end());
+            m_errors += container->getErrorCount();
+            delete(container);
+        }
+
+        err = CTOR_READ_SUCCESS;
+        Packet* packet = m_pending.front();
+        m_pending.pop_front();
+        return packet;
+    }
+
+    // The total number of sub packets that couldn't be decoded
+    uint64_t getErrorCount() {
+        return m_errors;
+    }
+
+private:
+    DataInputStream* m_in;
+    std::deque<Packet*> m_pending;
+    uint64_t m_errors;
+};
+
+#endif // !__IMPL_PACKETCONTAINER
@@ -0,0 +1,61 @@
+#ifndef __IMPL_PACKETCREDITGRANT
+#define __IMPL_PACKETCREDITGRANT
+
+#include "Packet.h"
+
+// Sent by a receiver to give the sender permission to send more data. The credits
+// are added to whatever the sender already had, they do not replace them
+//
+// [ Byte credits ] [ Frame credits ]
+// [      4b      ] [      2b       ]
+class PacketCreditGrant : public Packet {
+public:
+    PacketCreditGrant() {
+        m_bytes = 0;
+        m_frames = 0;
+    }
+
+    PacketCreditGrant(uint32_t bytes, uint16_t frames) {
+        m_bytes = bytes;
+        m_frames = frames;
+    }
+
+public:
+    uint8_t getId() override { return PACKET_ID_CREDIT_GRANT; }
+
+    uint8_t readPayload(DataInputStream* in, uint16_t len) override {
+        if (len != 6) {
+            return INVALID_PACKET_SZ;
+        }
+
+        m_bytes = in->readUInt();
+        m_frames = in->readUShort();
+        return CTOR_READ_SUCCESS;
+    }
+
+    uint8_t writePayload(DataOutputStream* out) override {
+        out->writeUInt(m_bytes);
+        out->writeUShort(m_frames);
+        return PKT_WRITE_SUCCESS;
+    }
+
+    uint16_t getPayloadSize() override {
+        return 6;
+    }
+
+    // The number of bytes (headers included) that the sender may now send
+    uint32_t getBytes() {
+        return m_bytes;
+    }
+
+    // The number of packets that the sender may now send
+    uint16_t getFrames() {
+        return m_frames;
+    }
+
+private:
+    uint32_t m_bytes;
+    uint16_t m_frames;
+};
+
+#endif // !__IMPL_PACKETCREDITGRANT
@@ -0,0 +1,143 @@
+#ifndef __IMPL_PACKETPROBE
+#define __IMPL_PACKETPROBE
+
+#include "Packet.h"
+
+// Sent to measure the link. The peer answers every probe with a PacketProbeReply, straight away
+//
+// [ Sequence ] [ Origin time ]
+// [    4b    ] [     8b      ]
+class PacketProbe : public Packet {
+public:
+    PacketProbe() {
+        m_seq = 0;
+        m_origin = 0;
+    }
+
+    PacketProbe(uint32_t seq, int64_t origin) {
+        m_seq = seq;
+        m_origin = origin;
+    }
+
+public:
+    uint8_t getId() override { return PACKET_ID_PROBE; }
+
+    uint8_t readPayload(DataInputStream* in, uint16_t len) override {
+        if (len != 12) {
+            return INVALID_PACKET_SZ;
+        }
+
+        m_seq = in->readUInt();
+        m_origin = in->readLong();
+        return CTOR_READ_SUCCESS;
+    }
+
+    uint8_t writePayload(DataOutputStream* out) override {
+        out->writeUInt(m_seq);
+        out->writeLong(m_origin);
+        return PKT_WRITE_SUCCESS;
+    }
+
+    uint16_t getPayloadSize() override {
+        return 12;
+    }
+
+    uint32_t getSeq() {
+        return m_seq;
+    }
+
+    // The sender's wall clock when the probe was sent, in microseconds since the unix epoch
+    int64_t getOrigin() {
+        return m_origin;
+    }
+
+private:
+    uint32_t m_seq;
+    int64_t m_origin;
+};
+
+// The answer to a PacketProbe. The times are microseconds since the unix epoch, on the replying side's wall clock
+//
+// [ Sequence ] [ Origin time ] [ Receive time ] [ Transmit time ] [ Bytes received ]
+// [    4b    ] [     8b      ] [      8b      ] [       8b      ] [       8b       ]
+class PacketProbeReply : public Packet {
+public:
+    PacketProbeReply() {
+        m_seq = 0;
+        m_origin = 0;
+        m_receive = 0;
+        m_transmit = 0;
+        m_received = 0;
+    }
+
+    PacketProbeReply(uint32_t seq, int64_t origin, int64_t receive, int64_t transmit, uint64_t received) {
+        m_seq = seq;
+        m_origin = origin;
+        m_receive = receive;
+        m_transmit = transmit;
+        m_received = received;
+    }
+
+public:
+    uint8_t getId() override { return PACKET_ID_PROBE_REPLY; }
+
+    uint8_t readPayload(DataInputStream* in, uint16_t len) override {
+        if (len != 36) {
+            return INVALID_PACKET_SZ;
+        }
+
+        m_seq = in->readUInt();
+        m_origin = in->readLong();
+        m_receive = in->readLong();
+        m_transmit = in->readLong();
+        m_received = in->readULong();
+        return CTOR_READ_SUCCESS;
+    }
+
+    uint8_t writePayload(DataOutputStream* out) override {
+        out->writeUInt(m_seq);
+        out->writeLong(m_origin);
+        out->writeLong(m_receive);
+        out->writeLong(m_transmit);
+        out->writeULong(m_received);
+        return PKT_WRITE_SUCCESS;
+    }
+
+    uint16_t getPayloadSize() override {
+        return 36;
+    }
+
+    // The sequence number of the probe being answered
+    uint32_t getSeq() {
+        return m_seq;
+    }
+
+    // The probe's origin time, echoed back
+    int64_t getOrigin() {
+        return m_origin;
+    }
+
+    // When the probe was received
+    int64_t getReceive() {
+        return m_receive;
+    }
+
+    // When this reply was sent
+    int64_t getTransmit() {
+        return m_transmit;
+    }
+
+    // The total number of bytes (headers included) the replying side had received when the probe arrived
+    uint64_t getReceived() {
+        return m_received;
+    }
+
+private:
+    uint32_t m_seq;
+    int64_t m_origin;
+    int64_t m_receive;
+    int64_t m_transmit;
+    uint64_t m_received;
+};
+
+#endif // !__IMPL_PACKETPROBE
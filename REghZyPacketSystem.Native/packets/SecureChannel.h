@@ -0,0 +1,414 @@
+#ifndef __IMPL_SECURECHANNEL
+#define __IMPL_SECURECHANNEL
+
+#include <atomic>
+#include <cstring>
+#include <utility>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include "Packet.h"
+#include "../data/ByteArrayInStream.h"
+#include "../data/ByteArrayOutStream.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__linux__) && defined(__aarch64__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+#define SECURE_PREFIX_LEN 5   // 1 byte key epoch, 4 byte frame counter
+#define SECURE_TAG_LEN 16
+#define SECURE_NONCE_LEN 12
+#define SECURE_OVERHEAD (SECURE_PREFIX_LEN + SECURE_TAG_LEN)
+#define SECURE_MAX_PAYLOAD (MAX_PAYLOAD_LEN - SECURE_OVERHEAD)
+#define SECURE_DEFAULT_REKEY_FRAMES (1u << 24)
+
+// The AEAD used for a SecureChannel. Both sides must use the same one
+enum SECURE_CIPHER : uint8_t {
+    SECURE_CIPHER_AES_256_GCM = 1,       // Fastest on CPUs with AES-NI and PCLMULQDQ (or the ARMv8 crypto extensions)
+    SECURE_CIPHER_CHACHA20_POLY1305 = 2  // Fastest on CPUs without AES instructions
+};
+
+// These use the upper byte with the low byte clear, so they never look like a
+// PROTOCOL_ERRCODE, or a payload read error (see PACKET_ERRCODE_MASK)
+enum SECURE_ERRCODE : uint16_t {
+    SECURE_AUTH_FAILED  = 0x0100, // The frame was corrupted, tampered with, or sealed with a different key
+    SECURE_REPLAYED     = 0x0200, // The frame's counter was not newer than the last frame's; it was already received
+    SECURE_BAD_EPOCH    = 0x0300, // The frame was sealed with a key epoch that is neither the current nor the next one
+    SECURE_CIPHER_ERROR = 0x0400  // The cipher couldn't be set up or failed to run
+};
+
+// Authenticated encryption of packet payloads on top of a DataStream
+//
+// The packet header stays as it is, and the payload becomes:
+// [ Epoch ] [ Counter ] [ Encrypted payload ] [ Tag ]
+// [  1b   ] [   4b    ] [ Len - 21 bytes    ] [ 16b ]
+//
+// The ID, length, epoch and counter are authenticated with the payload, so none of them can be altered.
+// Each direction has its own key chain, derived from the shared secret with HKDF-SHA256. The nonce is
+// the epoch's IV XORed with the frame counter, so it never repeats under the same key
+//
+// Rekeying needs no handshake. Every SECURE_DEFAULT_REKEY_FRAMES frames (or when rekey is called)
+// the sender moves to the next key in its chain and bumps the epoch. The receiver already has that key
+// ready, and switches over when the first frame of the new epoch authenticates. Each key is derived
+// one-way from the previous one, so old keys can't be recovered from the current one
+//
+// writePacket and readPacket may be called on different threads, but neither may be called by two
+// threads at once. Link with OpenSSL's libcrypto
+class SecureChannel {
+public:
+    // The initiator flag must be true on exactly one side; it picks which key chain is used for sending.
+    // The secret should be at least 32 bytes of key material (e.g. from a key exchange or a pre-shared key)
+    static SecureChannel* create(DataStream* stream, uint8_t cipher, const uint8_t* secret, size_t secretLen, bool initiator, uint16_t& err) {
+        SecureChannel* channel = new SecureChannel(stream, cipher);
+        if (!channel->init(secret, secretLen, initiator)) {
+            err = SECURE_CIPHER_ERROR;
+            delete(channel);
+            return nullptr;
+        }
+
+        err = PKT_WRITE_SUCCESS;
+        return channel;
+    }
+
+    ~SecureChannel() {
+        EVP_CIPHER_CTX_free(m_send.ctx);
+        EVP_CIPHER_CTX_free(m_sendNext.ctx);
+        EVP_CIPHER_CTX_free(m_recv.ctx);
+        EVP_CIPHER_CTX_free(m_recvNext.ctx);
+        OPENSSL_cleanse(m_sendChain, sizeof(m_sendChain));
+        OPENSSL_cleanse(m_recvChain, sizeof(m_recvChain));
+        delete(m_wdata);
+    }
+
+public:
+    // Picks the cipher that's fastest on this machine. Both sides must agree on the cipher,
+    // so only use this if the peer is told which one was picked, or has the same CPU
+    static uint8_t preferredCipher() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul")) {
+            return SECURE_CIPHER_AES_256_GCM;
+        }
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int info[4];
+        __cpuid(info, 1);
+        if ((info[2] & (1 << 25)) && (info[2] & (1 << 1))) {
+            return SECURE_CIPHER_AES_256_GCM;
+        }
+#elif defined(__linux__) && defined(__aarch64__)
+        unsigned long caps = getauxval(AT_HWCAP);
+        if ((caps & HWCAP_AES) && (caps & HWCAP_PMULL)) {
+            return SECURE_CIPHER_AES_256_GCM;
+        }
+#endif
+        return SECURE_CIPHER_CHACHA20_POLY1305;
+    }
+
+    // Encrypts the packet and writes it as a single frame. The payload can be at most SECURE_MAX_PAYLOAD bytes.
+    // Returns PKT_WRITE_SUCCESS, INVALID_PACKET_SZ, the packet's own write error, or SECURE_CIPHER_ERROR
+    uint16_t writePacket(Packet* packet) {
+        bool rotated = false;
+        if (m_rekeyRequested.exchange(false) || m_sendCounter >= m_rekeyFrames) {
+            // the next key is already derived, so switching is just a swap
+            std::swap(m_send, m_sendNext);
+            m_sendEpoch++;
+            m_sendCounter = 0;
+            rotated = true;
+        }
+
+        uint16_t err = sealFrame(packet);
+        if (rotated && !deriveEpoch(m_sendChain, m_sendNext, true)) {
+            err = SECURE_CIPHER_ERROR;
+        }
+
+        return err;
+    }
+
+    // Reads and decrypts the next frame, then decodes it like Packet::readPacket. On failure this returns
+    // nullptr, and err is one of PROTOCOL_ERRCODE, PACKET_ERRCODE or SECURE_ERRCODE. A frame that
+    // fails to authenticate is discarded without touching the key state, so forged frames are harmless
+    Packet* readPacket(uint16_t& err) {
+        err = Packet::readProtocolHeader(m_in);
+        if (!(err & PROTOCOL_SUC_MASK)) {
+            return nullptr;
+        }
+
+        uint8_t id = m_in->readByte();
+        uint16_t len = m_in->readUShort();
+        if (len < SECURE_OVERHEAD || len > MAX_PAYLOAD_LEN) {
+            err = PACKET_ERRCODE::INVALID_PACKET_SZ;
+            return nullptr;
+        }
+
+        // the frame is read whole and decrypted in place, so a bad frame never leaves the stream misaligned
+        uint8_t* frame = m_rbuf;
+        frame[0] = id;
+        frame[1] = (uint8_t)(len >> 8);
+        frame[2] = (uint8_t)len;
+        m_in->readFully(frame, 3, len);
+
+        uint8_t epoch = frame[3];
+        uint32_t counter = ((uint32_t)frame[4] << 24) | ((uint32_t)frame[5] << 16) | ((uint32_t)frame[6] << 8) | frame[7];
+        bool next = epoch == (uint8_t)(m_recvEpoch + 1);
+        if (!next && epoch != (uint8_t)m_recvEpoch) {
+            err = SECURE_BAD_EPOCH;
+            return nullptr;
+        }
+
+        if (!next && counter < m_recvCounter) {
+            err = SECURE_REPLAYED;
+            return nullptr;
+        }
+
+        uint16_t plainLen = len - SECURE_OVERHEAD;
+        uint8_t* plain = frame + 3 + SECURE_PREFIX_LEN;
+        if (!crypt(next ? m_recvNext : m_recv, false, counter, frame, 3 + SECURE_PREFIX_LEN, plain, plainLen, plain + plainLen)) {
+            m_authFailures++;
+            err = SECURE_AUTH_FAILED;
+            return nullptr;
+        }
+
+        if (next) {
+            std::swap(m_recv, m_recvNext);
+            m_recvEpoch++;
+            if (!deriveEpoch(m_recvChain, m_recvNext, false)) {
+                err = SECURE_CIPHER_ERROR;
+                return nullptr;
+            }
+        }
+
+        m_recvCounter = counter + 1;
+        pkt_ctor ctor = ctor_table[id];
+        if (ctor == nullptr) {
+            err = PACKET_ERRCODE::MISSING_PACKET_ID;
+            return nullptr;
+        }
+
+        ByteArrayInStream payload(plain, plainLen);
+        DataInputStream in(&payload);
+        Packet* packet = ctor();
+        uint8_t readErr;
+        try {
+            readErr = packet->readPayload(&in, plainLen);
+        }
+        catch (asio::system_error&) {
+            readErr = INVALID_PACKET_SZ; // the packet tried to read past its own payload
+        }
+
+        if (readErr) {
+            err = UTIL_COMB_PKR_ERROR(readErr);
+            delete(packet);
+            return nullptr;
+        }
+
+        err = PACKET_ERRCODE::CTOR_READ_SUCCESS;
+        return packet;
+    }
+
+    // Makes the next written frame use the next key. Safe to call from any thread
+    void rekey() {
+        m_rekeyRequested.store(true);
+    }
+
+    // Sets how many frames are sealed with each key before moving to the next one
+    void setRekeyInterval(uint32_t frames) {
+        m_rekeyFrames = frames == 0 ? 1 : frames;
+    }
+
+    uint8_t getCipher() {
+        return m_cipher;
+    }
+
+    // The number of times the sending key has changed
+    uint32_t getSendEpoch() {
+        return m_sendEpoch;
+    }
+
+    // The number of times the receiving key has changed
+    uint32_t getRecvEpoch() {
+        return m_recvEpoch;
+    }
+
+    // The number of received frames that failed to authenticate
+    uint64_t getAuthFailures() {
+        return m_authFailures;
+    }
+
+private:
+    struct EpochKey {
+        EVP_CIPHER_CTX* ctx;
+        uint8_t iv[SECURE_NONCE_LEN];
+    };
+
+    SecureChannel(DataStream* stream, uint8_t cipher) : m_rekeyRequested(false) {
+        m_out = stream->getOutput();
+        m_in = stream->getInput();
+        m_cipher = cipher;
+        m_wdata = new DataOutputStream(&m_wbuf);
+        m_send.ctx = EVP_CIPHER_CTX_new();
+        m_sendNext.ctx = EVP_CIPHER_CTX_new();
+        m_recv.ctx = EVP_CIPHER_CTX_new();
+        m_recvNext.ctx = EVP_CIPHER_CTX_new();
+        m_sendEpoch = 0;
+        m_recvEpoch = 0;
+        m_sendCounter = 0;
+        m_recvCounter = 0;
+        m_rekeyFrames = SECURE_DEFAULT_REKEY_FRAMES;
+        m_authFailures = 0;
+    }
+
+    bool init(const uint8_t* secret, size_t secretLen, bool initiator) {
+        if (getEvpCipher() == nullptr || !m_send.ctx || !m_sendNext.ctx || !m_recv.ctx || !m_recvNext.ctx) {
+            return false;
+        }
+
+        // HKDF-Extract, then one chain per direction. The cipher is part of the label, so two
+        // sides configured with different ciphers fail to authenticate instead of decoding garbage
+        uint8_t prk[32];
+        unsigned int prkLen = sizeof(prk);
+        const char* salt = "REghZyPacketSystem secure frames";
+        if (HMAC(EVP_sha256(), salt, (int)strlen(salt), secret, secretLen, prk, &prkLen) == nullptr) {
+            return false;
+        }
+
+        const char* initLabel = m_cipher == SECURE_CIPHER_AES_256_GCM ? "initiator aes-256-gcm" : "initiator chacha20-poly1305";
+        const char* respLabel = m_cipher == SECURE_CIPHER_AES_256_GCM ? "responder aes-256-gcm" : "responder chacha20-poly1305";
+        bool success = expand(prk, initiator ? initLabel : respLabel, m_sendChain, sizeof(m_sendChain)) &&
+                       expand(prk, initiator ? respLabel : initLabel, m_recvChain, sizeof(m_recvChain));
+        OPENSSL_cleanse(prk, sizeof(prk));
+        return success &&
+               deriveEpoch(m_sendChain, m_send, true) && deriveEpoch(m_sendChain, m_sendNext, true) &&
+               deriveEpoch(m_recvChain, m_recv, false) && deriveEpoch(m_recvChain, m_recvNext, false);
+    }
+
+    const EVP_CIPHER* getEvpCipher() {
+        switch (m_cipher) {
+            case SECURE_CIPHER_AES_256_GCM: return EVP_aes_256_gcm();
+            case SECURE_CIPHER_CHACHA20_POLY1305: return EVP_chacha20_poly1305();
+            default: return nullptr;
+        }
+    }
+
+    // HKDF-Expand, for outputs of up to 32 bytes (a single HMAC block)
+    static bool expand(const uint8_t* prk, const char* label, uint8_t* dst, size_t len) {
+        uint8_t info[64];
+        size_t labelLen = strlen(label);
+        memcpy(info, label, labelLen);
+        info[labelLen] = 1;
+        uint8_t block[32];
+        unsigned int blockLen = sizeof(block);
+        if (HMAC(EVP_sha256(), prk, 32, info, labelLen + 1, block, &blockLen) == nullptr) {
+            return false;
+        }
+
+        memcpy(dst, block, len);
+        OPENSSL_cleanse(block, sizeof(block));
+        return true;
+    }
+
+    // Sets up the key for the next epoch of a chain, then advances the chain past it
+    bool deriveEpoch(uint8_t* chain, EpochKey& key, bool encrypt) {
+        uint8_t cipherKey[32];
+        bool success = expand(chain, "key", cipherKey, sizeof(cipherKey)) &&
+                       expand(chain, "iv", key.iv, sizeof(key.iv)) &&
+                       expand(chain, "next", chain, 32);
+        if (success) {
+            success = EVP_CipherInit_ex(key.ctx, getEvpCipher(), nullptr, cipherKey, nullptr, encrypt ? 1 : 0) == 1;
+        }
+
+        OPENSSL_cleanse(cipherKey, sizeof(cipherKey));
+        return success;
+    }
+
+    // Seals or opens data in place. When opening, tag is the received tag, and false means it didn't match
+    static bool crypt(EpochKey& key, bool encrypt, uint32_t counter, const uint8_t* aad, int aadLen, uint8_t* data, int len, uint8_t* tag) {
+        uint8_t nonce[SECURE_NONCE_LEN];
+        memcpy(nonce, key.iv, SECURE_NONCE_LEN);
+        nonce[8] ^= (uint8_t)(counter >> 24);
+        nonce[9] ^= (uint8_t)(counter >> 16);
+        nonce[10] ^= (uint8_t)(counter >> 8);
+        nonce[11] ^= (uint8_t)counter;
+
+        int outLen;
+        if (EVP_CipherInit_ex(key.ctx, nullptr, nullptr, nullptr, nonce, encrypt ? 1 : 0) != 1 ||
+            EVP_CipherUpdate(key.ctx, nullptr, &outLen, aad, aadLen) != 1 ||
+            (len != 0 && EVP_CipherUpdate(key.ctx, data, &outLen, data, len) != 1)) {
+            return false;
+        }
+
+        if (encrypt) {
+            return EVP_CipherFinal_ex(key.ctx, data + len, &outLen) == 1 &&
+                   EVP_CIPHER_CTX_ctrl(key.ctx, EVP_CTRL_AEAD_GET_TAG, SECURE_TAG_LEN, tag) == 1;
+        }
+
+        return EVP_CIPHER_CTX_ctrl(key.ctx, EVP_CTRL_AEAD_SET_TAG, SECURE_TAG_LEN, tag) == 1 &&
+               EVP_CipherFinal_ex(key.ctx, data + len, &outLen) == 1;
+    }
+
+    uint16_t sealFrame(Packet* packet) {
+        uint16_t size = packet->getPayloadSize();
+        if (size > SECURE_MAX_PAYLOAD) {
+            return PACKET_ERRCODE::INVALID_PACKET_SZ;
+        }
+
+        m_wbuf.reset();
+        m_wdata->writeByte(PREAMBLE_SEQ1);
+        m_wdata->writeByte(PREAMBLE_SEQ2);
+        m_wdata->writeByte(PREAMBLE_SEQ3);
+        m_wdata->writeByte(PREAMBLE_SEQ4);
+        m_wdata->writeByte(packet->getId());
+        m_wdata->writeUShort(size + SECURE_OVERHEAD);
+        m_wdata->writeByte((uint8_t)m_sendEpoch);
+        m_wdata->writeUInt(m_sendCounter);
+        uint8_t err = packet->writePayload(m_wdata);
+        if (err) {
+            return err;
+        }
+
+        const int headerLen = PACKET_HEADER_LEN + SECURE_PREFIX_LEN;
+        if (m_wbuf.size() != (size_t)(headerLen + size)) {
+            return PACKET_ERRCODE::INVALID_PACKET_SZ; // getPayloadSize didn't match what writePayload wrote
+        }
+
+        // the ID onwards is authenticated, the same bytes the receiver has
+        uint8_t tag[SECURE_TAG_LEN];
+        uint8_t* frame = m_wbuf.getBuffer();
+        if (!crypt(m_send, true, m_sendCounter, frame + 4, headerLen - 4, frame + headerLen, size, tag)) {
+            return SECURE_CIPHER_ERROR;
+        }
+
+        // the counter is used up even if the write below fails, so a nonce is never sealed twice
+        m_sendCounter++;
+        m_wdata->write(tag, 0, SECURE_TAG_LEN);
+        m_out->write(m_wbuf.getBuffer(), 0, (uint16_t)m_wbuf.size());
+        m_out->flush();
+        return PKT_WRITE_SUCCESS;
+    }
+
+    DataOutputStream* m_out;
+    DataInputStream* m_in;
+    uint8_t m_cipher;
+
+    ByteArrayOutStream m_wbuf;
+    DataOutputStream* m_wdata;
+    uint8_t m_rbuf[3 + MAX_PAYLOAD_LEN];
+
+    EpochKey m_send;
+    EpochKey m_sendNext;
+    EpochKey m_recv;
+    EpochKey m_recvNext;
+    uint8_t m_sendChain[32];
+    uint8_t m_recvChain[32];
+    uint32_t m_sendEpoch;
+    uint32_t m_recvEpoch;
+    uint32_t m_sendCounter;
+    uint32_t m_recvCounter;
+    uint32_t m_rekeyFrames;
+    std::atomic<bool> m_rekeyRequested;
+    uint64_t m_authFailures;
+};
+
+#endif // !__IMPL_SECURECHANNEL
@@ -0,0 +1,206 @@
+// ContainerBench - measures what batching small packets into PacketContainers saves over writing
+// each one as its own frame, and checks that containers round trip
+//
+// Everything runs in memory (ByteArrayOutStream and ByteArrayInStream), so only the codec is measured:
+//     frames     - every packet is written with Packet::writePacket and read with Packet::readPacket
+//     containers - packets are written through ContainerWriter (flushed every --batch packets) and
+//                  read with ContainerReader
+//     check      - packets of mixed sizes batched with ContainerWriter must come out of ContainerReader
+//                  unchanged, and a container holding one packet must go on the wire as that packet
+//
+// Build from this directory with (asio being the standalone asio include directory):
+//     g++ -O2 -std=c++17 -I<asio> ContainerBench.cpp -o containerbench
+//
+// Example: 8 byte payloads, 1000000 packets, 64 packets per container
+//     containerbench --size 8 --count 1000000 --batch 64
+
+#define ASIO_STANDALONE
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "../packets/Packet.h"
+#include "../packets/PacketContainer.h"
+#include "../data/ByteArrayInStream.h"
+#include "../data/ByteArrayOutStream.h"
+
+#define BENCH_PACKET_ID 1
+
+static uint64_t nowNanos() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Carries an opaque payload of any size
+class BlobPacket : public Packet {
+public:
+    BlobPacket() {
+        m_size = 0;
+    }
+
+    BlobPacket(uint16_t size) {
+        m_size = size;
+    }
+
+public:
+    uint8_t getId() override { return BENCH_PACKET_ID; }
+
+    uint16_t getPayloadSize() override { return m_size; }
+
+    uint8_t readPayload(DataInputStream* in, uint16_t len) override {
+        m_size = len;
+        in->readFully(s_scratch, 0, len);
+        return CTOR_READ_SUCCESS;
+    }
+
+    uint8_t writePayload(DataOutputStream* out) override {
+        out->write(s_scratch, 0, m_size);
+        return PKT_WRITE_SUCCESS;
+    }
+
+private:
+    static uint8_t s_scratch[MAX_PAYLOAD_LEN];
+
+    uint16_t m_size;
+};
+
+uint8_t BlobPacket::s_scratch[MAX_PAYLOAD_LEN];
+
+static void printResult(const char* name, uint32_t count, size_t bytes, uint64_t encodeNanos, uint64_t decodeNanos) {
+    printf("  %-10s %8.2f bytes/packet  encode %7.1fns/packet  decode %7.1fns/packet\n", name, (double)bytes / count,
+           (double)encodeNanos / count, (double)decodeNanos / count);
+}
+
+static bool runFrames(uint16_t size, uint32_t count) {
+    ByteArrayOutStream wire((size_t)count * (PACKET_HEADER_LEN + size));
+    DataOutputStream out(&wire);
+    BlobPacket packet(size);
+    uint64_t start = nowNanos();
+    for (uint32_t i = 0; i < count; i++) {
+        Packet::writePacket(&out, &packet);
+    }
+
+    uint64_t encoded = nowNanos();
+    ByteArrayInStream in(wire.getBuffer(), wire.size());
+    DataInputStream din(&in);
+    uint16_t err;
+    for (uint32_t i = 0; i < count; i++) {
+        Packet* read = Packet::readPacket(&din, err);
+        if (read == nullptr) {
+            fprintf(stderr, "frames: failed to read packet %u: error 0x%x\n", i, err);
+            return false;
+        }
+
+        delete(read);
+    }
+
+    printResult("frames", count, wire.size(), encoded - start, nowNanos() - encoded);
+    return true;
+}
+
+static bool runContainers(uint16_t size, uint32_t count, uint32_t batch) {
+    ByteArrayOutStream wire((size_t)count * (CONTAINER_SUB_HEADER_LEN + size));
+    DataOutputStream out(&wire);
+    ContainerWriter writer(&out);
+    BlobPacket packet(size);
+    uint64_t start = nowNanos();
+    for (uint32_t i = 0; i < count; i++) {
+        writer.send(&packet);
+        if ((i + 1) % batch == 0) {
+            writer.flush();
+        }
+    }
+
+    writer.flush();
+    uint64_t encoded = nowNanos();
+    ByteArrayInStream in(wire.getBuffer(), wire.size());
+    DataInputStream din(&in);
+    ContainerReader reader(&din);
+    uint16_t err;
+    for (uint32_t i = 0; i < count; i++) {
+        Packet* read = reader.readPacket(err);
+        if (read == nullptr) {
+            fprintf(stderr, "containers: failed to read packet %u: error 0x%x\n", i, err);
+            return false;
+        }
+
+        delete(read);
+    }
+
+    printResult("containers", count, wire.size(), encoded - start, nowNanos() - encoded);
+    return true;
+}
+
+// Packets batched by ContainerWriter must be read back by ContainerReader in the same order, with the
+// same sizes, and a container holding one packet must go on the wire as that packet
+static bool checkRoundTrip() {
+    const uint16_t sizes[] = { 3, 0, 200, 5, 600, 7, CONTAINER_MAX_SUB_PAYLOAD, 9 };
+    const int count = sizeof(sizes) / sizeof(sizes[0]);
+    ByteArrayOutStream wire;
+    DataOutputStream out(&wire);
+    ContainerWriter writer(&out);
+    size_t singleStart = 0;
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        if (i == count - 1) {
+            ok = writer.flush() == PKT_WRITE_SUCCESS && ok;
+            singleStart = wire.size();
+        }
+
+        BlobPacket packet(sizes[i]);
+        ok = writer.send(&packet) == PKT_WRITE_SUCCESS && ok;
+    }
+
+    ok = writer.flush() == PKT_WRITE_SUCCESS && ok;
+    bool single = wire.size() == singleStart + PACKET_HEADER_LEN + sizes[count - 1] && wire.getBuffer()[singleStart + 4] == BENCH_PACKET_ID;
+
+    ByteArrayInStream in(wire.getBuffer(), wire.size());
+    DataInputStream din(&in);
+    ContainerReader reader(&din);
+    uint16_t err;
+    for (int i = 0; i < count; i++) {
+        Packet* packet = reader.readPacket(err);
+        ok = packet != nullptr && packet->getId() == BENCH_PACKET_ID && packet->getPayloadSize() == sizes[i] && ok;
+        delete(packet);
+    }
+
+    ok = ok && single && in.getRemaining() == 0 && reader.getErrorCount() == 0;
+    printf("  check      container round trip: %s\n", ok ? "yes" : "NO");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    uint16_t size = 16;
+    uint32_t count = 1000000;
+    uint32_t batch = 32;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        const char* value = (i + 1) < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr) {
+            printf("usage: containerbench [--size N] [--count N] [--batch N]\n");
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+
+        i++;
+        if (arg == "--size") size = (uint16_t)atoi(value);
+        else if (arg == "--count") count = (uint32_t)atoi(value);
+        else if (arg == "--batch") batch = (uint32_t)atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    if (size > CONTAINER_MAX_SUB_PAYLOAD || count == 0 || batch == 0) {
+        fprintf(stderr, "size must be 0-%u, and count and batch must be at least 1\n", CONTAINER_MAX_SUB_PAYLOAD);
+        return 1;
+    }
+
+    REGISTER_PACKET(BENCH_PACKET_ID, new BlobPacket());
+    REGISTER_PACKET(PACKET_ID_CONTAINER, new PacketContainer());
+    printf("%u byte payloads, %u packets, %u packets per container\n", size, count, batch);
+    bool ok = runFrames(size, count) && runContainers(size, count, batch);
+    ok = checkRoundTrip() && ok;
+    return ok ? 0 : 1;
+}
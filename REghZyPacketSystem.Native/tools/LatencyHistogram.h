@@ -0,0 +1,83 @@
+#ifndef __IMPL_LATENCYHISTOGRAM
+#define __IMPL_LATENCYHISTOGRAM
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// A log-linear latency histogram (16 buckets per power of 2, so within ~6% of the real value)
+class LatencyHistogram {
+public:
+    LatencyHistogram() {
+        memset(m_buckets, 0, sizeof(m_buckets));
+        m_count = 0;
+        m_max = 0;
+    }
+
+    void record(uint64_t nanos) {
+        m_buckets[indexOf(nanos)]++;
+        m_count++;
+        if (nanos > m_max) {
+            m_max = nanos;
+        }
+    }
+
+    void merge(LatencyHistogram& other) {
+        for (int i = 0; i < 1024; i++) {
+            m_buckets[i] += other.m_buckets[i];
+        }
+
+        m_count += other.m_count;
+        if (other.m_max > m_max) {
+            m_max = other.m_max;
+        }
+    }
+
+    // Gets the upper bound of the bucket holding the given percentile (0 - 1)
+    uint64_t percentile(double p) {
+        if (m_count == 0) {
+            return 0;
+        }
+
+        uint64_t target = (uint64_t)std::ceil(p * (double)m_count);
+        uint64_t seen = 0;
+        for (int i = 0; i < 1024; i++) {
+            seen += m_buckets[i];
+            if (seen >= target) {
+                uint64_t upper = valueOf(i + 1) - 1;
+                return upper > m_max ? m_max : upper;
+            }
+        }
+
+        return m_max;
+    }
+
+    uint64_t getCount() { return m_count; }
+
+    uint64_t getMax() { return m_max; }
+
+private:
+    static int indexOf(uint64_t v) {
+        if (v < 16) {
+            return (int)v;
+        }
+
+        int msb = 63 - __builtin_clzll(v);
+        return (msb - 3) * 16 + (int)((v >> (msb - 4)) & 15);
+    }
+
+    static uint64_t valueOf(int index) {
+        if (index < 16) {
+            return (uint64_t)index;
+        }
+
+        int msb = index / 16 + 3;
+        return (uint64_t)(16 + index % 16) << (msb - 4);
+    }
+
+    uint64_t m_buckets[1024];
+    uint64_t m_count;
+    uint64_t m_max;
+};
+
+#endif // !__IMPL_LATENCYHISTOGRAM
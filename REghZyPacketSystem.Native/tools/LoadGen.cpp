@@ -0,0 +1,618 @@
+// LoadGen - simulates many devices sending packets to a gateway, and reports the end-to-end
+// latency and sustained throughput of the native packet stack
+//
+// Every simulated device is a connection pair. Generator threads write packets (with
+// Packet::writePacket) into the device ends at a fixed rate, and gateway threads read the
+// gateway ends with epoll and decode them with Packet::readPacket, the same as a real gateway.
+// Each payload carries the time it was written, so the gateway can measure the latency
+//
+// Transports:
+//     pty   - a pseudo terminal pair per device (raw mode), the closest thing to a real serial port
+//     unix  - a unix stream socket pair per device
+//     mem   - no kernel at all; the generator hands the bytes straight to the decoder, which
+//             measures the cost of the codec on its own
+//
+// Linux only. Build from this directory with (asio being the standalone asio include directory):
+//     g++ -O2 -std=c++17 -I<asio> LoadGen.cpp -o loadgen -lpthread -lutil
+//
+// Example: 2000 devices on ptys, 50 packets/s each, 1% corrupted preambles, for 30 seconds
+//     loadgen --transport pty --devices 2000 --rate 50 --mix 1:16:80,2:128:15,3:1017:5 --corrupt 0.01 --duration 30
+
+#ifndef __linux__
+#error "LoadGen requires Linux"
+#endif // !__linux__
+
+#define ASIO_STANDALONE
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <pty.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "../packets/Packet.h"
+#include "../data/ByteArrayInStream.h"
+#include "../data/ByteArrayOutStream.h"
+#include "LatencyHistogram.h"
+
+#define LOADGEN_MIN_PAYLOAD 12  // send time (8 bytes) + device index (4 bytes)
+#define LOADGEN_BAD_PAYLOAD 0b00000100
+
+enum LOADGEN_TRANSPORT : uint8_t {
+    TRANSPORT_PTY,
+    TRANSPORT_UNIX,
+    TRANSPORT_MEM
+};
+
+static uint64_t nowNanos() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The packet sent by every simulated device. The payload is the time it was written and the
+// device that wrote it, padded out to the size picked from the packet mix
+class LoadPacket : public Packet {
+public:
+    LoadPacket() {
+        m_id = 0;
+        m_size = 0;
+        m_sendTime = 0;
+        m_device = 0;
+    }
+
+    LoadPacket(uint8_t id, uint16_t size, uint64_t sendTime, uint32_t device) {
+        m_id = id;
+        m_size = size;
+        m_sendTime = sendTime;
+        m_device = device;
+    }
+
+public:
+    uint8_t getId() override { return m_id; }
+
+    uint16_t getPayloadSize() override { return m_size; }
+
+    uint8_t readPayload(DataInputStream* in, uint16_t len) override {
+        // a corrupted header can land anywhere, so the length can't be trusted to fit the layout
+        m_size = len;
+        if (len < LOADGEN_MIN_PAYLOAD) {
+            in->readFully(s_scratch, 0, len);
+            return LOADGEN_BAD_PAYLOAD;
+        }
+
+        m_sendTime = in->readULong();
+        m_device = in->readUInt();
+        in->readFully(s_scratch, 0, len - LOADGEN_MIN_PAYLOAD);
+        return CTOR_READ_SUCCESS;
+    }
+
+    uint8_t writePayload(DataOutputStream* out) override {
+        out->writeULong(m_sendTime);
+        out->writeUInt(m_device);
+        out->write(s_scratch, 0, m_size - LOADGEN_MIN_PAYLOAD);
+        return PKT_WRITE_SUCCESS;
+    }
+
+    uint64_t getSendTime() {
+        return m_sendTime;
+    }
+
+private:
+    static thread_local uint8_t s_scratch[MAX_PAYLOAD_LEN];
+
+    uint8_t m_id;
+    uint16_t m_size;
+    uint64_t m_sendTime;
+    uint32_t m_device;
+};
+
+thread_local uint8_t LoadPacket::s_scratch[MAX_PAYLOAD_LEN];
+
+struct MixEntry {
+    uint8_t id;
+    uint16_t size;
+    uint32_t weight;
+};
+
+struct Config {
+    uint8_t transport = TRANSPORT_UNIX;
+    uint32_t devices = 100;
+    double rate = 100.0;           // packets per second, per device
+    double duration = 10.0;        // seconds
+    double corrupt = 0.0;          // chance of a packet getting a corrupted preamble byte
+    uint32_t genThreads = 2;
+    uint32_t gatewayThreads = 2;
+    std::vector<MixEntry> mix;
+    uint32_t totalWeight = 0;
+};
+
+// The state of a single simulated device and the gateway's end of its connection
+struct Device {
+    uint32_t index = 0;
+    int deviceFd = -1;
+    int gatewayFd = -1;
+    uint64_t nextSend = 0;
+    std::vector<uint8_t> rx;       // bytes received by the gateway, but not decoded yet
+};
+
+struct GeneratorStats {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t corrupted = 0;
+    uint64_t late = 0;             // sends that fell more than one interval behind the schedule
+};
+
+struct GatewayStats {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    std::map<uint16_t, uint64_t> errors;
+    LatencyHistogram latency;
+};
+
+static std::atomic<bool> g_generating(true);
+static std::atomic<bool> g_receiving(true);
+static std::atomic<uint64_t> g_liveSent(0);
+static std::atomic<uint64_t> g_liveReceived(0);
+
+static uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// Decodes as many whole packets as possible from the device's received bytes
+static void decode(Device* device, GatewayStats& stats) {
+    std::vector<uint8_t>& rx = device->rx;
+    ByteArrayInStream in(rx.data(), rx.size());
+    DataInputStream din(&in);
+    while (in.getRemaining() >= PACKET_HEADER_LEN) {
+        // wait for the whole frame, rather than decoding it again every time a few more bytes arrive
+        size_t start = in.getPosition();
+        const uint8_t* frame = rx.data() + start;
+        if (frame[0] == PREAMBLE_SEQ1 && frame[1] == PREAMBLE_SEQ2 && frame[2] == PREAMBLE_SEQ3 && frame[3] == PREAMBLE_SEQ4) {
+            size_t len = (size_t)((frame[5] << 8) | frame[6]);
+            if (len <= MAX_PAYLOAD_LEN && in.getRemaining() < (PACKET_HEADER_LEN + len)) {
+                break;
+            }
+        }
+
+        uint16_t err;
+        Packet* packet;
+        try {
+            packet = Packet::readPacket(&din, err);
+        }
+        catch (asio::system_error&) {
+            // only part of a packet has arrived so far (readPacket has already deleted it)
+            in.setPosition(start);
+            break;
+        }
+
+        stats.bytes += in.getPosition() - start;
+        if (packet == nullptr) {
+            stats.errors[err]++;
+            continue;
+        }
+
+        uint64_t now = nowNanos();
+        uint64_t sent = ((LoadPacket*)packet)->getSendTime();
+        if (sent <= now) {
+            stats.latency.record(now - sent);
+        }
+
+        stats.frames++;
+        delete(packet);
+    }
+
+    rx.erase(rx.begin(), rx.begin() + in.getPosition());
+}
+
+static void gatewayMain(std::vector<Device*> devices, GatewayStats* stats) {
+    int epfd = epoll_create1(0);
+    for (Device* device : devices) {
+        fcntl(device->gatewayFd, F_SETFL, fcntl(device->gatewayFd, F_GETFL) | O_NONBLOCK);
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = device;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, device->gatewayFd, &ev);
+    }
+
+    epoll_event events[256];
+    uint8_t buffer[65536];
+    while (g_receiving.load(std::memory_order_relaxed)) {
+        int count = epoll_wait(epfd, events, 256, 100);
+        for (int i = 0; i < count; i++) {
+            Device* device = (Device*)events[i].data.ptr;
+            while (true) {
+                ssize_t n = ::read(device->gatewayFd, buffer, sizeof(buffer));
+                if (n <= 0) {
+                    break;
+                }
+
+                device->rx.insert(device->rx.end(), buffer, buffer + n);
+                uint64_t before = stats->frames;
+                decode(device, *stats);
+                g_liveReceived.fetch_add(stats->frames - before, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    close(epfd);
+}
+
+static void generatorMain(Config* config, std::vector<Device*> devices, GeneratorStats* stats, GatewayStats* memStats, uint64_t seed) {
+    uint64_t interval = (uint64_t)(1e9 / config->rate);
+    uint64_t rng = seed | 1;
+    ByteArrayOutStream buffer(PACKET_HEADER_LEN + MAX_PAYLOAD_LEN);
+    DataOutputStream out(&buffer);
+
+    uint64_t now = nowNanos();
+    for (Device* device : devices) {
+        // spread the devices over the first interval, so they don't all send at once
+        device->nextSend = now + (xorshift(rng) % interval);
+    }
+
+    while (g_generating.load(std::memory_order_relaxed)) {
+        now = nowNanos();
+        uint64_t wake = now + 1000000;
+        for (Device* device : devices) {
+            while (device->nextSend <= now) {
+                uint32_t pick = (uint32_t)(xorshift(rng) % config->totalWeight);
+                MixEntry* entry = &config->mix[0];
+                for (MixEntry& e : config->mix) {
+                    if (pick < e.weight) {
+                        entry = &e;
+                        break;
+                    }
+
+                    pick -= e.weight;
+                }
+
+                LoadPacket packet(entry->id, entry->size, nowNanos(), device->index);
+                buffer.reset();
+                Packet::writePacket(&out, &packet);
+                if (config->corrupt > 0.0 && (double)(xorshift(rng) % 1000000) < (config->corrupt * 1000000.0)) {
+                    // flip the top bit of one of the preamble bytes, which is never a valid preamble byte
+                    buffer.getBuffer()[xorshift(rng) % 4] ^= 0x80;
+                    stats->corrupted++;
+                }
+
+                if (config->transport == TRANSPORT_MEM) {
+                    device->rx.insert(device->rx.end(), buffer.getBuffer(), buffer.getBuffer() + buffer.size());
+                    decode(device, *memStats);
+                }
+                else {
+                    uint8_t* ptr = buffer.getBuffer();
+                    size_t remaining = buffer.size();
+                    while (remaining != 0) {
+                        ssize_t n = ::write(device->deviceFd, ptr, remaining);
+                        if (n < 0) {
+                            if (errno == EINTR) {
+                                continue;
+                            }
+
+                            fprintf(stderr, "write failed for device %u: %s\n", device->index, strerror(errno));
+                            return;
+                        }
+
+                        ptr += n;
+                        remaining -= (size_t)n;
+                    }
+                }
+
+                stats->frames++;
+                stats->bytes += buffer.size();
+                g_liveSent.fetch_add(1, std::memory_order_relaxed);
+                device->nextSend += interval;
+                if (device->nextSend + interval < now) {
+                    // the device can't keep up; count it and skip the backlog rather than bursting
+                    stats->late++;
+                    device->nextSend = now + interval;
+                }
+            }
+
+            if (device->nextSend < wake) {
+                wake = device->nextSend;
+            }
+        }
+
+        now = nowNanos();
+        if (wake > now) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(wake - now));
+        }
+    }
+}
+
+static bool openDevice(Config& config, Device* device) {
+    if (config.transport == TRANSPORT_MEM) {
+        return true;
+    }
+
+    if (config.transport == TRANSPORT_UNIX) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+            return false;
+        }
+
+        device->deviceFd = fds[0];
+        device->gatewayFd = fds[1];
+        return true;
+    }
+
+    int master, slave;
+    if (openpty(&master, &slave, nullptr, nullptr, nullptr) == -1) {
+        return false;
+    }
+
+    // raw mode, so the line discipline passes the bytes through untouched
+    termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    device->deviceFd = master;
+    device->gatewayFd = slave;
+    return true;
+}
+
+static bool parseMix(Config& config, const char* arg) {
+    std::string mix(arg);
+    size_t pos = 0;
+    while (pos < mix.size()) {
+        size_t end = mix.find(',', pos);
+        if (end == std::string::npos) {
+            end = mix.size();
+        }
+
+        unsigned id, size, weight;
+        if (sscanf(mix.substr(pos, end - pos).c_str(), "%u:%u:%u", &id, &size, &weight) != 3) {
+            fprintf(stderr, "bad mix entry '%s', expected id:size:weight\n", mix.substr(pos, end - pos).c_str());
+            return false;
+        }
+
+        if (id >= PACKET_ID_RESERVED_MIN) {
+            fprintf(stderr, "packet id %u is reserved (must be below %u)\n", id, PACKET_ID_RESERVED_MIN);
+            return false;
+        }
+
+        if (size < LOADGEN_MIN_PAYLOAD || size > MAX_PAYLOAD_LEN) {
+            fprintf(stderr, "payload size %u must be between %u and %u\n", size, LOADGEN_MIN_PAYLOAD, MAX_PAYLOAD_LEN);
+            return false;
+        }
+
+        config.mix.push_back({ (uint8_t)id, (uint16_t)size, weight });
+        config.totalWeight += weight;
+        pos = end + 1;
+    }
+
+    return config.totalWeight != 0;
+}
+
+static void printUsage() {
+    printf("usage: loadgen [options]\n"
+           "  --transport pty|unix|mem  how each device is connected to the gateway (default unix)\n"
+           "  --devices N               number of simulated devices (default 100)\n"
+           "  --rate N                  packets per second, per device (default 100)\n"
+           "  --duration S              seconds to generate load for (default 10)\n"
+           "  --mix id:size:weight,...  packet ids, payload sizes (%u-%u) and weights (default 1:16:1)\n"
+           "  --corrupt P               chance (0-1) of corrupting a preamble byte (default 0)\n"
+           "  --gen-threads N           generator threads (default 2)\n"
+           "  --gw-threads N            gateway threads (default 2)\n",
+           LOADGEN_MIN_PAYLOAD, MAX_PAYLOAD_LEN);
+}
+
+static const char* errorName(uint16_t err) {
+    switch (err) {
+        case PROTOCOL_ERR_TTTF: return "PROTOCOL_ERR_TTTF";
+        case PROTOCOL_ERR_TTF0: return "PROTOCOL_ERR_TTF0";
+        case PROTOCOL_ERR_TF00: return "PROTOCOL_ERR_TF00";
+        case PROTOCOL_ERR_FTTF: return "PROTOCOL_ERR_FTTF";
+        case PROTOCOL_ERR_FTF0: return "PROTOCOL_ERR_FTF0";
+        case PROTOCOL_ERR_FFTF: return "PROTOCOL_ERR_FFTF";
+        case PROTOCOL_ERR_FFF0: return "PROTOCOL_ERR_FFF0";
+        case MISSING_PACKET_ID: return "MISSING_PACKET_ID";
+        case INVALID_PACKET_SZ: return "INVALID_PACKET_SZ";
+        default: return (err & PACKET_ERRCODE_MASK) ? "payload read error" : "other";
+    }
+}
+
+static void printMicros(const char* label, uint64_t nanos) {
+    printf("  %s %.1f us", label, (double)nanos / 1000.0);
+}
+
+int main(int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        const char* value = (i + 1) < argc ? argv[i + 1] : nullptr;
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return 0;
+        }
+
+        if (value == nullptr) {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return 1;
+        }
+
+        i++;
+        if (arg == "--transport") {
+            std::string t(value);
+            if (t == "pty") config.transport = TRANSPORT_PTY;
+            else if (t == "unix") config.transport = TRANSPORT_UNIX;
+            else if (t == "mem") config.transport = TRANSPORT_MEM;
+            else {
+                fprintf(stderr, "unknown transport '%s'\n", value);
+                return 1;
+            }
+        }
+        else if (arg == "--devices") config.devices = (uint32_t)atoi(value);
+        else if (arg == "--rate") config.rate = atof(value);
+        else if (arg == "--duration") config.duration = atof(value);
+        else if (arg == "--corrupt") config.corrupt = atof(value);
+        else if (arg == "--gen-threads") config.genThreads = (uint32_t)atoi(value);
+        else if (arg == "--gw-threads") config.gatewayThreads = (uint32_t)atoi(value);
+        else if (arg == "--mix") {
+            if (!parseMix(config, value)) {
+                return 1;
+            }
+        }
+        else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (config.mix.empty()) {
+        parseMix(config, "1:16:1");
+    }
+
+    if (config.devices == 0 || config.rate <= 0.0 || config.genThreads == 0 || config.gatewayThreads == 0) {
+        fprintf(stderr, "devices, rate and thread counts must be above 0\n");
+        return 1;
+    }
+
+    for (MixEntry& entry : config.mix) {
+        REGISTER_PACKET(entry.id, new LoadPacket());
+    }
+
+    // every device needs 2 file descriptors
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    std::vector<Device*> devices;
+    for (uint32_t i = 0; i < config.devices; i++) {
+        Device* device = new Device();
+        device->index = i;
+        if (!openDevice(config, device)) {
+            fprintf(stderr, "failed to open device %u: %s\n", i, strerror(errno));
+            return 1;
+        }
+
+        devices.push_back(device);
+    }
+
+    const char* transportNames[] = { "pty", "unix", "mem" };
+    printf("%u devices over %s, %.1f packets/s each, %.1f s\n", config.devices, transportNames[config.transport], config.rate, config.duration);
+
+    uint32_t gatewayCount = config.transport == TRANSPORT_MEM ? 0 : config.gatewayThreads;
+    std::vector<GatewayStats> gatewayStats(gatewayCount);
+    std::vector<std::thread> gateways;
+    for (uint32_t t = 0; t < gatewayCount; t++) {
+        std::vector<Device*> slice;
+        for (uint32_t i = t; i < config.devices; i += gatewayCount) {
+            slice.push_back(devices[i]);
+        }
+
+        gateways.emplace_back(gatewayMain, slice, &gatewayStats[t]);
+    }
+
+    // with TRANSPORT_MEM the generator threads do the decoding, so they get their own gateway stats
+    std::vector<GeneratorStats> generatorStats(config.genThreads);
+    std::vector<GatewayStats> memStats(config.genThreads);
+    std::vector<std::thread> generators;
+    uint64_t start = nowNanos();
+    for (uint32_t t = 0; t < config.genThreads; t++) {
+        std::vector<Device*> slice;
+        for (uint32_t i = t; i < config.devices; i += config.genThreads) {
+            slice.push_back(devices[i]);
+        }
+
+        generators.emplace_back(generatorMain, &config, slice, &generatorStats[t], &memStats[t], start + t * 0x9E3779B97F4A7C15ull);
+    }
+
+    uint64_t lastSent = 0, lastReceived = 0;
+    for (int second = 1; second <= (int)std::ceil(config.duration); second++) {
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(start + (uint64_t)second * 1000000000ull)));
+        uint64_t sent = g_liveSent.load(), received = g_liveReceived.load();
+        if (config.transport == TRANSPORT_MEM) {
+            received = sent;
+        }
+
+        printf("[%3ds] sent %8llu/s  received %8llu/s\n", second, (unsigned long long)(sent - lastSent), (unsigned long long)(received - lastReceived));
+        fflush(stdout);
+        lastSent = sent;
+        lastReceived = received;
+    }
+
+    g_generating = false;
+    for (std::thread& thread : generators) {
+        thread.join();
+    }
+
+    double elapsed = (double)(nowNanos() - start) / 1e9;
+
+    // give the gateways a moment to drain whatever is still in flight
+    uint64_t sentTotal = g_liveSent.load();
+    for (int i = 0; i < 20 && config.transport != TRANSPORT_MEM && g_liveReceived.load() < sentTotal; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    g_receiving = false;
+    for (std::thread& thread : gateways) {
+        thread.join();
+    }
+
+    GeneratorStats sent;
+    for (GeneratorStats& s : generatorStats) {
+        sent.frames += s.frames;
+        sent.bytes += s.bytes;
+        sent.corrupted += s.corrupted;
+        sent.late += s.late;
+    }
+
+    GatewayStats received;
+    for (GatewayStats& s : config.transport == TRANSPORT_MEM ? memStats : gatewayStats) {
+        received.frames += s.frames;
+        received.bytes += s.bytes;
+        received.latency.merge(s.latency);
+        for (auto& e : s.errors) {
+            received.errors[e.first] += e.second;
+        }
+    }
+
+    uint64_t errorCount = 0;
+    for (auto& e : received.errors) {
+        errorCount += e.second;
+    }
+
+    printf("\nsent       %llu packets (%.2f MB), %llu corrupted, %llu late\n",
+           (unsigned long long)sent.frames, (double)sent.bytes / 1e6, (unsigned long long)sent.corrupted, (unsigned long long)sent.late);
+    printf("received   %llu packets, %llu decode errors, %lld lost\n",
+           (unsigned long long)received.frames, (unsigned long long)errorCount, (long long)(sent.frames - received.frames));
+    printf("throughput %.0f packets/s, %.2f MB/s\n", (double)received.frames / elapsed, (double)received.bytes / elapsed / 1e6);
+    printf("latency   ");
+    printMicros("p50", received.latency.percentile(0.50));
+    printMicros("p99", received.latency.percentile(0.99));
+    printMicros("p999", received.latency.percentile(0.999));
+    printMicros("max", received.latency.getMax());
+    printf("\n");
+    for (auto& e : received.errors) {
+        printf("  %-20s (0x%04x) %llu\n", errorName(e.first), e.first, (unsigned long long)e.second);
+    }
+
+    for (Device* device : devices) {
+        if (device->deviceFd != -1) {
+            close(device->deviceFd);
+            close(device->gatewayFd);
+        }
+
+        delete(device);
+    }
+
+    return 0;
+}
@@ -0,0 +1,266 @@
+// SecureFrameBench - measures how fast a single core can seal and open SecureChannel frames
+//
+// One side writes packets into memory and the other reads them back, so nothing but the
+// packet codec and the cipher are measured. Each payload size is run with both ciphers,
+// and the time covers encrypting and decrypting every frame
+//
+// Build from this directory with (asio being the standalone asio include directory):
+//     g++ -O2 -std=c++17 -I<asio> SecureFrameBench.cpp -o securebench -lcrypto
+//
+// Example: payloads of 64, 256 and the maximum size, rekeying every 4096 frames
+//     securebench --sizes 64,256,996 --rekey 4096
+
+#define ASIO_STANDALONE
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../packets/SecureChannel.h"
+
+#define BENCH_PACKET_ID 1
+
+static uint64_t nowNanos() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Carries an opaque payload of any size
+class BlobPacket : public Packet {
+public:
+    BlobPacket() {
+        m_size = 0;
+    }
+
+    BlobPacket(uint16_t size) {
+        m_size = size;
+    }
+
+public:
+    uint8_t getId() override { return BENCH_PACKET_ID; }
+
+    uint16_t getPayloadSize() override { return m_size; }
+
+    uint8_t readPayload(DataInputStream* in, uint16_t len) override {
+        m_size = len;
+        in->readFully(s_scratch, 0, len);
+        return CTOR_READ_SUCCESS;
+    }
+
+    uint8_t writePayload(DataOutputStream* out) override {
+        out->write(s_scratch, 0, m_size);
+        return PKT_WRITE_SUCCESS;
+    }
+
+private:
+    static uint8_t s_scratch[MAX_PAYLOAD_LEN];
+
+    uint16_t m_size;
+};
+
+uint8_t BlobPacket::s_scratch[MAX_PAYLOAD_LEN];
+
+// A one way, in-memory link between a sender and a receiver
+struct Link {
+    ByteArrayOutStream wire;
+    ByteArrayInStream reader;
+    DataStream sendStream;
+    DataStream recvStream;
+    SecureChannel* sender;
+    SecureChannel* receiver;
+
+    Link() : sendStream(&wire, nullptr), recvStream(nullptr, &reader) {
+        sender = nullptr;
+        receiver = nullptr;
+    }
+
+    ~Link() {
+        delete(sender);
+        delete(receiver);
+    }
+
+    bool open(uint8_t cipher, uint8_t recvCipher, uint32_t rekeyFrames) {
+        uint8_t secret[32];
+        for (int i = 0; i < 32; i++) {
+            secret[i] = (uint8_t)(i * 7 + 1);
+        }
+
+        uint16_t err;
+        sender = SecureChannel::create(&sendStream, cipher, secret, sizeof(secret), true, err);
+        receiver = SecureChannel::create(&recvStream, recvCipher, secret, sizeof(secret), false, err);
+        if (sender == nullptr || receiver == nullptr) {
+            return false;
+        }
+
+        sender->setRekeyInterval(rekeyFrames);
+        return true;
+    }
+
+    // Points the receiver at whatever the sender has written since the last call
+    void deliver() {
+        m_pending = wire.release();
+        reader.reset(m_pending.data(), m_pending.size());
+    }
+
+    std::vector<uint8_t> m_pending;
+};
+
+static const char* cipherName(uint8_t cipher) {
+    return cipher == SECURE_CIPHER_AES_256_GCM ? "aes-256-gcm" : "chacha20-poly1305";
+}
+
+// Checks that tampering, replays and mismatched ciphers are all rejected, and that rekeying works
+static bool selfTest(uint8_t cipher) {
+    Link link;
+    if (!link.open(cipher, cipher, 3)) {
+        return false;
+    }
+
+    uint16_t err;
+    BlobPacket packet(100);
+    for (int i = 0; i < 10; i++) {
+        link.sender->writePacket(&packet);
+    }
+
+    link.deliver();
+    std::vector<uint8_t> copy = link.m_pending;
+    for (int i = 0; i < 10; i++) {
+        Packet* received = link.receiver->readPacket(err);
+        if (received == nullptr || received->getPayloadSize() != 100) {
+            fprintf(stderr, "  round trip failed (error 0x%x)\n", err);
+            return false;
+        }
+
+        delete(received);
+    }
+
+    if (link.receiver->getRecvEpoch() != 3) {
+        fprintf(stderr, "  expected 3 rekeys, got %u\n", link.receiver->getRecvEpoch());
+        return false;
+    }
+
+    // the last frame again is a replay
+    size_t frameLen = PACKET_HEADER_LEN + 100 + SECURE_OVERHEAD;
+    link.reader.reset(copy.data() + copy.size() - frameLen, frameLen);
+    if (link.receiver->readPacket(err) != nullptr || err != SECURE_REPLAYED) {
+        fprintf(stderr, "  replay wasn't rejected (error 0x%x)\n", err);
+        return false;
+    }
+
+    link.sender->writePacket(&packet);
+    link.deliver();
+    link.m_pending[PACKET_HEADER_LEN + SECURE_PREFIX_LEN + 10] ^= 1;
+    if (link.receiver->readPacket(err) != nullptr || err != SECURE_AUTH_FAILED) {
+        fprintf(stderr, "  tampered frame wasn't rejected (error 0x%x)\n", err);
+        return false;
+    }
+
+    Link mismatch;
+    uint8_t other = cipher == SECURE_CIPHER_AES_256_GCM ? SECURE_CIPHER_CHACHA20_POLY1305 : SECURE_CIPHER_AES_256_GCM;
+    if (!mismatch.open(cipher, other, SECURE_DEFAULT_REKEY_FRAMES)) {
+        return false;
+    }
+
+    mismatch.sender->writePacket(&packet);
+    mismatch.deliver();
+    if (mismatch.receiver->readPacket(err) != nullptr || err != SECURE_AUTH_FAILED) {
+        fprintf(stderr, "  mismatched cipher wasn't rejected (error 0x%x)\n", err);
+        return false;
+    }
+
+    return true;
+}
+
+static bool run(uint8_t cipher, uint16_t size, uint32_t frames, uint32_t rekeyFrames) {
+    Link link;
+    if (!link.open(cipher, cipher, rekeyFrames)) {
+        fprintf(stderr, "failed to set up %s\n", cipherName(cipher));
+        return false;
+    }
+
+    // sealed and opened in batches, so the in-memory wire stays small
+    const uint32_t batch = 256;
+    BlobPacket packet(size);
+    uint16_t err;
+    uint64_t start = nowNanos();
+    for (uint32_t done = 0; done < frames; done += batch) {
+        for (uint32_t i = 0; i < batch; i++) {
+            link.sender->writePacket(&packet);
+        }
+
+        link.deliver();
+        for (uint32_t i = 0; i < batch; i++) {
+            Packet* received = link.receiver->readPacket(err);
+            if (received == nullptr) {
+                fprintf(stderr, "failed to open a frame: error 0x%x\n", err);
+                return false;
+            }
+
+            delete(received);
+        }
+    }
+
+    double seconds = (double)(nowNanos() - start) / 1e9;
+    uint64_t total = ((frames + batch - 1) / batch) * batch;
+    printf("  %-18s %5u bytes  %9.0f frames/s  %6.2f Gbit/s  %4u rekeys\n", cipherName(cipher), size,
+           (double)total / seconds, (double)total * size * 8.0 / seconds / 1e9, link.receiver->getRecvEpoch());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::vector<uint16_t> sizes = { 64, 256, SECURE_MAX_PAYLOAD };
+    uint32_t frames = 200000;
+    uint32_t rekeyFrames = SECURE_DEFAULT_REKEY_FRAMES;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        const char* value = (i + 1) < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr) {
+            printf("usage: securebench [--sizes N,N,...] [--frames N] [--rekey N]\n");
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+
+        i++;
+        if (arg == "--frames") frames = (uint32_t)atoi(value);
+        else if (arg == "--rekey") rekeyFrames = (uint32_t)atoi(value);
+        else if (arg == "--sizes") {
+            sizes.clear();
+            for (const char* p = value; *p; ) {
+                int size = atoi(p);
+                if (size < 0 || size > SECURE_MAX_PAYLOAD) {
+                    fprintf(stderr, "sizes must be 0-%u\n", SECURE_MAX_PAYLOAD);
+                    return 1;
+                }
+
+                sizes.push_back((uint16_t)size);
+                const char* comma = strchr(p, ',');
+                p = comma ? comma + 1 : p + strlen(p);
+            }
+        }
+        else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    REGISTER_PACKET(BENCH_PACKET_ID, new BlobPacket());
+    printf("preferred cipher on this machine: %s\n", cipherName(SecureChannel::preferredCipher()));
+    uint8_t ciphers[] = { SECURE_CIPHER_AES_256_GCM, SECURE_CIPHER_CHACHA20_POLY1305 };
+    for (uint8_t cipher : ciphers) {
+        if (!selfTest(cipher)) {
+            fprintf(stderr, "%s failed its self test\n", cipherName(cipher));
+            return 1;
+        }
+    }
+
+    for (uint16_t size : sizes) {
+        for (uint8_t cipher : ciphers) {
+            if (!run(cipher, size, frames, rekeyFrames)) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
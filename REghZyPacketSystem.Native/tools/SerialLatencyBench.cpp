@@ -0,0 +1,374 @@
+// SerialLatencyBench - measures the round trip latency and streaming throughput of the packet
+// stack over LinuxSerialPort, with its latency and throughput optimised settings
+//
+// Each mode runs two phases:
+//     ping    - one packet is written and the echo is read back before the next is written,
+//               which is what request/response traffic over a serial link looks like
+//     stream  - a writer thread sends packets back to back (up to BENCH_STREAM_WINDOW bytes ahead)
+//               while the echoes are read, which shows how many read syscalls each packet costs
+//               when the data doesn't stop
+//
+// By default the far end is a pseudo terminal, echoed by a thread in this process. Use --port
+// to test a real port instead, whose TX and RX pins are wired together (a loopback plug)
+//
+// Linux only. Build from this directory with (asio being the standalone asio include directory):
+//     g++ -O2 -std=c++17 -I<asio> SerialLatencyBench.cpp -o seriallatencybench -lpthread -lutil
+//
+// Example: an FTDI adapter with a loopback plug, with its latency timer turned down to 1ms
+//     seriallatencybench --port /dev/ttyUSB0 --baud 921600 --ftdi-timer 1 --size 32
+
+#ifndef __linux__
+#error "SerialLatencyBench requires Linux"
+#endif // !__linux__
+
+#define ASIO_STANDALONE
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <errno.h>
+#include <pty.h>
+#include <unistd.h>
+
+#include "../packets/Packet.h"
+#include "../data/BufferedOutStream.h"
+#include "../data/serial/LinuxSerialInStream.h"
+#include "../data/serial/LinuxSerialOutStream.h"
+#include "LatencyHistogram.h"
+
+#define BENCH_PACKET_ID 1
+#define BENCH_MIN_PAYLOAD 8 // send time
+
+// The most bytes the stream writer may be ahead of the reader. This has to be well above VMIN (up to 255),
+// or a stalled writer leaves the reader waiting out the VTIME gap for bytes that won't come, and well below
+// the pty's 4KB buffer, or the echo would fill it up and stall
+#define BENCH_STREAM_WINDOW 2048
+
+static uint64_t nowNanos() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The payload is the time the packet was written, padded out to the requested size
+class BenchPacket : public Packet {
+public:
+    BenchPacket() {
+        m_size = BENCH_MIN_PAYLOAD;
+        m_sendTime = 0;
+    }
+
+    BenchPacket(uint16_t size, uint64_t sendTime) {
+        m_size = size;
+        m_sendTime = sendTime;
+    }
+
+public:
+    uint8_t getId() override { return BENCH_PACKET_ID; }
+
+    uint16_t getPayloadSize() override { return m_size; }
+
+    uint8_t readPayload(DataInputStream* in, uint16_t len) override {
+        if (len < BENCH_MIN_PAYLOAD) {
+            return INVALID_PACKET_SZ;
+        }
+
+        m_size = len;
+        m_sendTime = in->readULong();
+        in->readFully(s_scratch, 0, len - BENCH_MIN_PAYLOAD);
+        return CTOR_READ_SUCCESS;
+    }
+
+    uint8_t writePayload(DataOutputStream* out) override {
+        out->writeULong(m_sendTime);
+        out->write(s_scratch, 0, m_size - BENCH_MIN_PAYLOAD);
+        return PKT_WRITE_SUCCESS;
+    }
+
+    uint64_t getSendTime() {
+        return m_sendTime;
+    }
+
+private:
+    static thread_local uint8_t s_scratch[MAX_PAYLOAD_LEN];
+
+    uint16_t m_size;
+    uint64_t m_sendTime;
+};
+
+thread_local uint8_t BenchPacket::s_scratch[MAX_PAYLOAD_LEN];
+
+struct Config {
+    const char* port = nullptr;    // null for a pty
+    uint32_t baud = 115200;
+    uint16_t size = 32;            // payload size
+    uint32_t count = 1000;         // packets per phase
+    double limit = 5.0;            // the most seconds a phase may take
+    int ftdiTimer = -1;
+    bool runLatency = true;
+    bool runThroughput = true;
+};
+
+// Writes back whatever the pty master receives, standing in for a device that echoes every packet
+static void echoLoop(int fd, std::atomic<bool>* running) {
+    uint8_t buffer[4096];
+    while (running->load(std::memory_order_relaxed)) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+
+            return;
+        }
+
+        uint8_t* src = buffer;
+        while (n > 0) {
+            ssize_t written = write(fd, src, (size_t)n);
+            if (written <= 0) {
+                if (written == -1 && errno == EINTR) {
+                    continue;
+                }
+
+                return;
+            }
+
+            src += written;
+            n -= written;
+        }
+    }
+}
+
+static void printMicros(const char* label, uint64_t nanos) {
+    printf("  %s %.1f us", label, (double)nanos / 1000.0);
+}
+
+static bool readEcho(DataInputStream* in, LatencyHistogram& histogram) {
+    uint16_t err;
+    Packet* packet = Packet::readPacket(in, err);
+    if (packet == nullptr) {
+        fprintf(stderr, "failed to read the echo: error 0x%x\n", err);
+        return false;
+    }
+
+    histogram.record(nowNanos() - ((BenchPacket*)packet)->getSendTime());
+    delete(packet);
+    return true;
+}
+
+static bool runPing(Config& config, LinuxSerialInStream* instream, DataInputStream* in, DataOutputStream* out) {
+    LatencyHistogram histogram;
+    uint64_t reads = instream->getReadCalls();
+    uint64_t start = nowNanos();
+    uint64_t deadline = start + (uint64_t)(config.limit * 1e9);
+    for (uint32_t i = 0; i < config.count && nowNanos() < deadline; i++) {
+        BenchPacket packet(config.size, nowNanos());
+        Packet::writePacket(out, &packet);
+        if (!readEcho(in, histogram)) {
+            return false;
+        }
+    }
+
+    uint64_t n = histogram.getCount();
+    printf("    ping   %6llu packets", (unsigned long long) n);
+    printMicros("p50", histogram.percentile(0.5));
+    printMicros("p99", histogram.percentile(0.99));
+    printMicros("max", histogram.getMax());
+    printf("  %.2f reads/packet\n", n ? (double)(instream->getReadCalls() - reads) / (double)n : 0.0);
+    return true;
+}
+
+static bool runStream(Config& config, LinuxSerialInStream* instream, DataInputStream* in, DataOutputStream* out) {
+    uint32_t window = BENCH_STREAM_WINDOW / (PACKET_HEADER_LEN + config.size);
+    if (window == 0) {
+        window = 1;
+    }
+
+    std::atomic<uint32_t> received(0);
+    std::atomic<bool> failed(false);
+    std::thread writer([&]() {
+        for (uint32_t i = 0; i < config.count && !failed.load(); i++) {
+            while ((i - received.load(std::memory_order_acquire)) >= window && !failed.load()) {
+                std::this_thread::yield();
+            }
+
+            BenchPacket packet(config.size, nowNanos());
+            Packet::writePacket(out, &packet);
+        }
+    });
+
+    LatencyHistogram histogram;
+    uint64_t reads = instream->getReadCalls();
+    uint64_t start = nowNanos();
+    for (uint32_t i = 0; i < config.count; i++) {
+        if (!readEcho(in, histogram)) {
+            failed.store(true);
+            break;
+        }
+
+        received.store(i + 1, std::memory_order_release);
+    }
+
+    writer.join();
+    if (failed.load()) {
+        return false;
+    }
+
+    double seconds = (double)(nowNanos() - start) / 1e9;
+    uint64_t n = histogram.getCount();
+    printf("    stream %6llu packets", (unsigned long long) n);
+    printMicros("p50", histogram.percentile(0.5));
+    printMicros("p99", histogram.percentile(0.99));
+    printf("  %.0f packets/s  %.1f KB/s  %.2f reads/packet\n",
+           (double)n / seconds, (double)n * (config.size + PACKET_HEADER_LEN) / seconds / 1024.0,
+           n ? (double)(instream->getReadCalls() - reads) / (double)n : 0.0);
+    return true;
+}
+
+static bool runMode(Config& config, const char* name, const LinuxSerialConfig& serial) {
+    int echo = -1;
+    LinuxSerialPort* port;
+    asio::error_code err;
+    if (config.port == nullptr) {
+        int slave;
+        if (openpty(&echo, &slave, nullptr, nullptr, nullptr) == -1) {
+            fprintf(stderr, "openpty failed: %s\n", strerror(errno));
+            return false;
+        }
+
+        // the master has no line discipline of its own, so only the slave needs setting up
+        port = LinuxSerialPort::attach(slave, serial, err);
+        if (port == nullptr) {
+            close(slave);
+        }
+    }
+    else {
+        port = LinuxSerialPort::open(config.port, serial, err);
+    }
+
+    if (port == nullptr) {
+        fprintf(stderr, "failed to open the port: %s\n", err.message().c_str());
+        if (echo != -1) {
+            close(echo);
+        }
+
+        return false;
+    }
+
+    std::atomic<bool> running(true);
+    std::thread echoThread;
+    if (echo != -1) {
+        echoThread = std::thread(echoLoop, echo, &running);
+    }
+
+    printf("  %s (VMIN %u, VTIME %u, batch %u, low latency %s)\n", name, serial.vmin, serial.vtime,
+           serial.readBatch, port->isLowLatency() ? "on" : (serial.lowLatency ? "unsupported" : "off"));
+
+    LinuxSerialInStream instream(port);
+    LinuxSerialOutStream outstream(port);
+
+    // buffered like DataStream does (but big enough for any frame), so each packet is a single write syscall
+    BufferedOutStream buffered(&outstream, PACKET_HEADER_LEN + MAX_PAYLOAD_LEN);
+    DataInputStream* in = new DataInputStream(&instream);
+    DataOutputStream* out = new DataOutputStream(&buffered);
+    bool success = runPing(config, &instream, in, out) && runStream(config, &instream, in, out);
+
+    running.store(false);
+    if (echo != -1) {
+        // closing our end makes the echo thread's read fail, if it's still waiting
+        port->close();
+        echoThread.join();
+        close(echo);
+    }
+
+    delete(in);
+    delete(out);
+    delete(port);
+    return success;
+}
+
+static void printUsage() {
+    printf("usage: seriallatencybench [options]\n"
+           "  --port PATH             a serial port with a loopback plug (default: an echoed pty)\n"
+           "  --baud N                baud rate (default 115200)\n"
+           "  --size N                payload size, %u-%u (default 32)\n"
+           "  --count N               packets per phase (default 1000)\n"
+           "  --limit S               the most seconds a ping phase may take (default 5)\n"
+           "  --mode latency|throughput|both  which settings to test (default both)\n"
+           "  --ftdi-timer MS         set the FTDI latency timer of --port first (needs root)\n",
+           BENCH_MIN_PAYLOAD, MAX_PAYLOAD_LEN);
+}
+
+int main(int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        const char* value = (i + 1) < argc ? argv[i + 1] : nullptr;
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return 0;
+        }
+
+        if (value == nullptr) {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return 1;
+        }
+
+        i++;
+        if (arg == "--port") config.port = value;
+        else if (arg == "--baud") config.baud = (uint32_t)atoi(value);
+        else if (arg == "--size") config.size = (uint16_t)atoi(value);
+        else if (arg == "--count") config.count = (uint32_t)atoi(value);
+        else if (arg == "--limit") config.limit = atof(value);
+        else if (arg == "--ftdi-timer") config.ftdiTimer = atoi(value);
+        else if (arg == "--mode") {
+            std::string mode(value);
+            config.runLatency = mode == "latency" || mode == "both";
+            config.runThroughput = mode == "throughput" || mode == "both";
+            if (!config.runLatency && !config.runThroughput) {
+                fprintf(stderr, "unknown mode '%s'\n", value);
+                return 1;
+            }
+        }
+        else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (config.size < BENCH_MIN_PAYLOAD || config.size > MAX_PAYLOAD_LEN || config.count == 0) {
+        printUsage();
+        return 1;
+    }
+
+    if (config.ftdiTimer >= 0) {
+        if (config.port == nullptr) {
+            fprintf(stderr, "--ftdi-timer needs --port\n");
+            return 1;
+        }
+
+        const char* name = strrchr(config.port, '/');
+        asio::error_code err;
+        LinuxSerialPort::setFtdiLatencyTimer(name ? name + 1 : config.port, (uint8_t)config.ftdiTimer, err);
+        if (err) {
+            fprintf(stderr, "failed to set the FTDI latency timer: %s\n", err.message().c_str());
+            return 1;
+        }
+    }
+
+    REGISTER_PACKET(BENCH_PACKET_ID, new BenchPacket());
+
+    printf("%s, %u baud, %u byte payloads\n", config.port ? config.port : "pty", config.baud, config.size);
+    if (config.runLatency && !runMode(config, "latency optimised", LinuxSerialConfig::latencyOptimised(config.baud))) {
+        return 1;
+    }
+
+    if (config.runThroughput && !runMode(config, "throughput optimised", LinuxSerialConfig::throughputOptimised(config.baud))) {
+        return 1;
+    }
+
+    return 0;
+}
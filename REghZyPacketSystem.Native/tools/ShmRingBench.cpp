@@ -0,0 +1,309 @@
+// ShmRingBench - measures the packet stack over SharedMemoryRing between two processes
+//
+// The process forks, and the child echoes every packet back through a second ring (answering link probes
+// with LinkProbe). Four phases run:
+//     ping    - one packet is written and the echo is read back before the next is written. Half of the
+//               round trip is the one way handoff latency (sub-microsecond needs 2 free cores, so the spin
+//               loop can catch the data; with 1 core every handoff is a futex wake and a context switch)
+//     stream  - a writer thread sends packets back to back while the echoes are read
+//     probe   - LinkProbe measures the ring: the SRTT and RTO must settle near the ping round trip, a probe
+//               whose reply isn't read within the RTO must double it, and the clock offset must be near 0,
+//               since both processes share a clock
+//     checks  - a ring with a corrupt capacity must fail to open, and a reader must notice that the
+//               writer process died without closing its ring (within SHM_RING_LIVENESS_MS)
+//
+// Linux only. Build from this directory with (asio being the standalone asio include directory):
+//     g++ -O2 -std=c++17 -I<asio> ShmRingBench.cpp -o shmringbench -lpthread
+//
+// Example: 64 byte payloads, 200000 pings, with a 1MB ring each way
+//     shmringbench --size 64 --count 200000 --capacity 1048576
+
+#ifndef __linux__
+#error "ShmRingBench requires Linux"
+#endif // !__linux__
+
+#define ASIO_STANDALONE
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <sys/wait.h>
+
+#include "../packets/Packet.h"
+#include "../packets/LinkProbe.h"
+#include "../data/shm/SharedMemInStream.h"
+#include "../data/shm/SharedMemOutStream.h"
+#include "LatencyHistogram.h"
+
+#define BENCH_PACKET_ID 1
+#define BENCH_PROBES 200
+#define BENCH_PROBE_MIN_RTO 100 // microseconds, so the RTO follows the ring instead of sitting at the 10ms default floor
+
+static uint64_t nowNanos() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Carries an opaque payload of any size
+class BlobPacket : public Packet {
+public:
+    BlobPacket() {
+        m_size = 0;
+    }
+
+    BlobPacket(uint16_t size) {
+        m_size = size;
+    }
+
+public:
+    uint8_t getId() override { return BENCH_PACKET_ID; }
+
+    uint16_t getPayloadSize() override { return m_size; }
+
+    uint8_t readPayload(DataInputStream* in, uint16_t len) override {
+        m_size = len;
+        in->readFully(s_scratch, 0, len);
+        return CTOR_READ_SUCCESS;
+    }
+
+    uint8_t writePayload(DataOutputStream* out) override {
+        out->write(s_scratch, 0, m_size);
+        return PKT_WRITE_SUCCESS;
+    }
+
+private:
+    static uint8_t s_scratch[MAX_PAYLOAD_LEN];
+
+    uint16_t m_size;
+};
+
+uint8_t BlobPacket::s_scratch[MAX_PAYLOAD_LEN];
+
+// Echoes packets until the ring is closed, then exits the child process
+static void runEcho(SharedMemoryRing* in, SharedMemoryRing* out) {
+    SharedMemInStream input(in);
+    SharedMemOutStream output(out);
+    DataStream stream(&output, &input);
+    LinkProbe link(&stream, std::chrono::hours(1)); // only answers probes
+    uint16_t err;
+    try {
+        while (true) {
+            Packet* packet = link.readPacket(err);
+            if (packet == nullptr) {
+                break;
+            }
+
+            link.writePacket(packet);
+            stream.flushWrite();
+            delete(packet);
+        }
+    }
+    catch (asio::system_error&) {
+        // the parent closed the ring
+    }
+
+    out->close();
+    _exit(0);
+}
+
+static bool runPing(DataStream& stream, uint16_t size, uint32_t count) {
+    BlobPacket packet(size);
+    LatencyHistogram histogram;
+    uint16_t err;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t start = nowNanos();
+        Packet::writePacket(stream.getOutput(), &packet);
+        stream.flushWrite();
+        Packet* echo = Packet::readPacket(stream.getInput(), err);
+        if (echo == nullptr) {
+            fprintf(stderr, "ping: failed to read the echo: error 0x%x\n", err);
+            return false;
+        }
+
+        histogram.record(nowNanos() - start);
+        delete(echo);
+    }
+
+    printf("  ping    %5u bytes  round trip p50 %6.2fus  p99 %6.2fus  max %8.2fus\n", size,
+           histogram.percentile(0.5) / 1000.0, histogram.percentile(0.99) / 1000.0, histogram.getMax() / 1000.0);
+    return true;
+}
+
+static bool runStream(DataStream& stream, uint16_t size, uint32_t count) {
+    uint64_t start = nowNanos();
+    std::thread writer([&]() {
+        BlobPacket packet(size);
+        for (uint32_t i = 0; i < count; i++) {
+            Packet::writePacket(stream.getOutput(), &packet);
+        }
+
+        stream.flushWrite();
+    });
+
+    uint16_t err;
+    for (uint32_t i = 0; i < count; i++) {
+        Packet* echo = Packet::readPacket(stream.getInput(), err);
+        if (echo == nullptr) {
+            fprintf(stderr, "stream: failed to read echo %u: error 0x%x\n", i, err);
+            writer.join();
+            return false;
+        }
+
+        delete(echo);
+    }
+
+    writer.join();
+    double seconds = (double)(nowNanos() - start) / 1e9;
+    printf("  stream  %5u bytes  %10.0f packets/s  %8.1f MB/s each way\n", size,
+           (double)count / seconds, (double)count * (PACKET_HEADER_LEN + size) / seconds / 1e6);
+    return true;
+}
+
+// Each probe is followed by a ping, whose echo comes back after the probe's reply, so readPacket (which
+// consumes replies itself) never waits for a reply that isn't coming
+static bool runProbe(DataStream& stream) {
+    LinkProbe link(&stream, std::chrono::hours(1));
+    LinkEstimator& estimator = link.getEstimator();
+    estimator.setRtoBounds(BENCH_PROBE_MIN_RTO, LINK_DEFAULT_MAX_RTO);
+    BlobPacket ping(0);
+    uint16_t err;
+    for (uint32_t i = 0; i < BENCH_PROBES; i++) {
+        link.probe();
+        link.writePacket(&ping);
+        Packet* echo = link.readPacket(err);
+        if (echo == nullptr) {
+            fprintf(stderr, "probe: failed to read the echo: error 0x%x\n", err);
+            return false;
+        }
+
+        delete(echo);
+    }
+
+    LinkEstimate settled = estimator.getEstimate();
+    bool converged = settled.samples == BENCH_PROBES && settled.srtt > 0 && settled.srtt < 1000 && settled.rto < 10000;
+    bool offset = settled.clockOffset > -1000 && settled.clockOffset < 1000;
+
+    // this probe is answered straight away, but the reply isn't read until after the RTO has passed
+    link.probe();
+    std::this_thread::sleep_for(std::chrono::microseconds(settled.rto * 2 + 1000));
+    link.poll();
+    LinkEstimate backedOff = estimator.getEstimate();
+    bool doubled = backedOff.lost == 1 && backedOff.rto == settled.rto * 2;
+
+    // the late reply is ignored, so it doesn't count as a sample
+    link.writePacket(&ping);
+    Packet* echo = link.readPacket(err);
+    delete(echo);
+    bool ignored = echo != nullptr && estimator.getEstimate().samples == BENCH_PROBES;
+
+    printf("  probe   srtt %lldus  rttvar %lldus  rto %lldus  offset %lldus  converged: %s, offset near 0: %s\n",
+           (long long) settled.srtt, (long long) settled.rttVar, (long long) settled.rto, (long long) settled.clockOffset,
+           converged ? "yes" : "NO", offset ? "yes" : "NO");
+    printf("  probe   unanswered probe doubled the rto: %s (%lldus), late reply ignored: %s\n",
+           doubled ? "yes" : "NO", (long long) backedOff.rto, ignored ? "yes" : "NO");
+    return converged && offset && doubled && ignored;
+}
+
+// A ring whose header claims a capacity that isn't a power of 2 must be rejected
+static bool checkCorruptCapacity() {
+    asio::error_code err;
+    SharedMemoryRing* ring = SharedMemoryRing::createAnonymous(4096, err);
+    if (ring == nullptr) {
+        return false;
+    }
+
+    int fd = dup(ring->getFd());
+    uint32_t capacity = 100;
+    bool resized = ftruncate(fd, (off_t)(SHM_RING_DATA_OFFSET + capacity)) == 0;
+    bool patched = pwrite(fd, &capacity, sizeof(capacity), offsetof(ShmRingHeader, capacity)) == sizeof(capacity);
+    delete(ring);
+    SharedMemoryRing* opened = SharedMemoryRing::open(fd, err);
+    bool rejected = resized && patched && opened == nullptr && err == asio::error::invalid_argument;
+    delete(opened);
+    printf("  check   corrupt capacity rejected: %s\n", rejected ? "yes" : "NO");
+    return rejected;
+}
+
+// A writer process that dies without closing its ring must not leave the reader blocked
+static bool checkDeadWriter() {
+    asio::error_code err;
+    SharedMemoryRing* ring = SharedMemoryRing::createAnonymous(4096, err);
+    if (ring == nullptr) {
+        return false;
+    }
+
+    SharedMemInStream input(ring);
+    pid_t child = fork();
+    if (child == 0) {
+        ring->attachProducer();
+        _exit(0); // like a crash: the ring is never closed
+    }
+
+    waitpid(child, nullptr, 0);
+    uint64_t start = nowNanos();
+    uint8_t byte;
+    input.read(&byte, 0, 1, err);
+    double millis = (double)(nowNanos() - start) / 1e6;
+    bool noticed = err == asio::error::eof;
+    printf("  check   dead writer noticed: %s, after %.1fms\n", noticed ? "yes" : "NO", millis);
+    delete(ring);
+    return noticed;
+}
+
+int main(int argc, char** argv) {
+    uint16_t size = 64;
+    uint32_t count = 100000;
+    uint32_t capacity = 1 << 20;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        const char* value = (i + 1) < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr) {
+            printf("usage: shmringbench [--size N] [--count N] [--capacity N]\n");
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+
+        i++;
+        if (arg == "--size") size = (uint16_t)atoi(value);
+        else if (arg == "--count") count = (uint32_t)atoi(value);
+        else if (arg == "--capacity") capacity = (uint32_t)atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    if (size > MAX_PAYLOAD_LEN) {
+        fprintf(stderr, "size must be 0-%u\n", MAX_PAYLOAD_LEN);
+        return 1;
+    }
+
+    REGISTER_PACKET(BENCH_PACKET_ID, new BlobPacket());
+    REGISTER_PACKET(PACKET_ID_PROBE, new PacketProbe());
+    REGISTER_PACKET(PACKET_ID_PROBE_REPLY, new PacketProbeReply());
+    asio::error_code err;
+    SharedMemoryRing* toChild = SharedMemoryRing::createAnonymous(capacity, err);
+    SharedMemoryRing* toParent = err ? nullptr : SharedMemoryRing::createAnonymous(capacity, err);
+    if (err) {
+        fprintf(stderr, "failed to create the rings: %s\n", err.message().c_str());
+        return 1;
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        runEcho(toChild, toParent);
+    }
+
+    printf("%ld cores online, ring capacity %u\n", sysconf(_SC_NPROCESSORS_ONLN), toChild->getCapacity());
+    SharedMemInStream input(toParent);
+    SharedMemOutStream output(toChild);
+    DataStream stream(&output, &input);
+    bool ok = runPing(stream, size, count) && runStream(stream, size, count) && runProbe(stream);
+    toChild->close();
+    waitpid(child, nullptr, 0);
+    ok = checkCorruptCapacity() && ok;
+    ok = checkDeadWriter() && ok;
+    delete(toChild);
+    delete(toParent);
+    return ok ? 0 : 1;
+}
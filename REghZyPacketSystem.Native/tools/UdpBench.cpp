@@ -0,0 +1,189 @@
+// UdpBench - measures UdpTransport throughput over loopback, and how many syscalls each packet costs
+//
+// A sender and a receiver transport run in the same process, on separate threads. The sender queues
+// packets and flushes every --batch packets, and the receiver counts what arrives (UDP may drop
+// datagrams when the receiver falls behind, so the loss is reported rather than treated as an error)
+//
+// Build from this directory with (asio being the standalone asio include directory):
+//     g++ -O2 -std=c++17 -I<asio> UdpBench.cpp -o udpbench -pthread
+//
+// Example: 64 byte payloads, flushing every 256 packets, with and without GSO
+//     udpbench --size 64 --batch 256 --count 2000000
+
+#ifndef __linux__
+#error "UdpBench requires Linux"
+#endif // !__linux__
+
+#define ASIO_STANDALONE
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "../data/udp/UdpTransport.h"
+
+#define BENCH_PACKET_ID 1
+
+static uint64_t nowNanos() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Carries a sequence number, padded out to the payload size
+class SeqPacket : public Packet {
+public:
+    SeqPacket() {
+        m_seq = 0;
+        m_size = 4;
+    }
+
+    SeqPacket(uint32_t seq, uint16_t size) {
+        m_seq = seq;
+        m_size = size < 4 ? 4 : size;
+    }
+
+public:
+    uint8_t getId() override { return BENCH_PACKET_ID; }
+
+    uint16_t getPayloadSize() override { return m_size; }
+
+    uint32_t getSeq() { return m_seq; }
+
+    uint8_t readPayload(DataInputStream* in, uint16_t len) override {
+        if (len < 4) {
+            return INVALID_PACKET_SZ;
+        }
+
+        m_size = len;
+        m_seq = in->readInt();
+        in->readFully(s_scratch, 0, len - 4);
+        return CTOR_READ_SUCCESS;
+    }
+
+    uint8_t writePayload(DataOutputStream* out) override {
+        out->writeInt(m_seq);
+        out->write(s_scratch, 0, m_size - 4);
+        return PKT_WRITE_SUCCESS;
+    }
+
+private:
+    static uint8_t s_scratch[MAX_PAYLOAD_LEN];
+
+    uint32_t m_seq;
+    uint16_t m_size;
+};
+
+uint8_t SeqPacket::s_scratch[MAX_PAYLOAD_LEN];
+
+static bool run(uint16_t size, uint32_t count, uint32_t batch, bool gso) {
+    asio::error_code ec;
+    UdpTransport* receiver = UdpTransport::open("127.0.0.1", 0, ec);
+    UdpTransport* sender = ec ? nullptr : UdpTransport::open("127.0.0.1", 0, ec);
+    if (ec) {
+        fprintf(stderr, "failed to open a socket: %s\n", ec.message().c_str());
+        return false;
+    }
+
+    int rcvbuf = 8 << 20;
+    setsockopt(receiver->getFd(), SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    receiver->setReceiveTimeout(200);
+    receiver->setAcceptUnknownPeers(false);
+    receiver->addPeer("127.0.0.1", sender->getLocalPort(), ec);
+    UdpPeer* target = sender->addPeer("127.0.0.1", receiver->getLocalPort(), ec);
+    bool gsoEnabled = sender->setGso(gso);
+
+    std::atomic<bool> sending(true);
+    uint64_t received = 0;
+    uint64_t reordered = 0;
+    uint64_t errors = 0;
+    std::thread reader([&]() {
+        uint32_t next = 0;
+        UdpPeer* peer;
+        uint16_t err;
+        asio::error_code rec;
+        while (true) {
+            Packet* packet = receiver->readPacket(peer, err, rec);
+            if (packet == nullptr) {
+                if (rec) {
+                    rec.clear();
+                    if (!sending.load()) {
+                        break; // timed out after the sender finished
+                    }
+                }
+                else {
+                    errors++;
+                }
+
+                continue;
+            }
+
+            uint32_t seq = ((SeqPacket*) packet)->getSeq();
+            if (seq < next) {
+                reordered++;
+            }
+
+            next = seq + 1;
+            received++;
+            delete(packet);
+        }
+    });
+
+    uint64_t start = nowNanos();
+    for (uint32_t i = 0; i < count; i++) {
+        SeqPacket packet(i, size);
+        sender->send(target, &packet);
+        if (((i + 1) % batch) == 0) {
+            sender->flush(ec);
+        }
+    }
+
+    sender->flush(ec);
+    uint64_t sendNanos = nowNanos() - start;
+    sending.store(false);
+    reader.join();
+    if (ec) {
+        fprintf(stderr, "send failed: %s\n", ec.message().c_str());
+    }
+
+    double seconds = (double) sendNanos / 1e9;
+    printf("  %5u bytes  gso %-3s  %10.0f packets/s sent  %5.1f%% received  %6.4f sends/packet  %6.4f recvs/packet  %llu datagrams  %llu reordered  %llu errors\n",
+           size, gsoEnabled ? "on" : "off", (double) count / seconds, 100.0 * (double) received / count,
+           (double) sender->getSendCalls() / count, received ? (double) receiver->getRecvCalls() / received : 0.0,
+           (unsigned long long) target->getDatagramsSent(), (unsigned long long) reordered, (unsigned long long) errors);
+    delete(sender);
+    delete(receiver);
+    return !ec;
+}
+
+int main(int argc, char** argv) {
+    uint16_t size = 64;
+    uint32_t count = 1000000;
+    uint32_t batch = 256;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        const char* value = (i + 1) < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr) {
+            printf("usage: udpbench [--size N] [--count N] [--batch N]\n");
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+
+        i++;
+        if (arg == "--size") size = (uint16_t) atoi(value);
+        else if (arg == "--count") count = (uint32_t) atoi(value);
+        else if (arg == "--batch") batch = (uint32_t) atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    if (size < 4 || size > MAX_PAYLOAD_LEN || batch == 0) {
+        fprintf(stderr, "size must be 4-%u, and batch must be at least 1\n", MAX_PAYLOAD_LEN);
+        return 1;
+    }
+
+    REGISTER_PACKET(BENCH_PACKET_ID, new SeqPacket());
+    return run(size, count, batch, false) && run(size, count, batch, true) ? 0 : 1;
+}
@@ -3,6 +3,7 @@ using REghZyPacketSystem.Systems;
 using System;
 using System.Threading;
 using REghZyPacketSystem.Packeting;
+using REghZyPacketSystem.Packeting.Probe;
 
 namespace REghZyPacketSystem.Testing {
     class Program {
@@ -12,6 +13,9 @@ namespace REghZyPacketSystem.Testing {
         public AckProcessor2Counter counterA;
         public AckProcessor2Counter counterB;
 
+        public ProbeProcessor probeA;
+        public ProbeProcessor probeB;
+
         public static void Main(string[] args) {
             // i don't like not using the 'this' keyword :(
             new Program();
@@ -22,6 +26,8 @@ namespace REghZyPacketSystem.Testing {
             this.systemA = new ThreadPacketSystem(new SerialConnection("COM20"));
             this.systemB = new ThreadPacketSystem(new SerialConnection("COM21"));
             this.counterB = new AckProcessor2Counter(this.systemB);
+            this.probeA = new ProbeProcessor(this.systemA, 50);
+            this.probeB = new ProbeProcessor(this.systemB, 50);
 
             this.systemA.RegisterListener<Packet1Chat>((p) => {
                 Console.WriteLine($"[B] -> [A] \"{p.msg}\"");
@@ -42,6 +48,14 @@ namespace REghZyPacketSystem.Testing {
             Thread.Sleep(5);
             this.systemA.SendPacket(new Packet1Chat() { msg = "ello there lol" });
             Thread.Sleep(1000);
+
+            // measure the link from A's side; B answers the probes
+            for (int i = 0; i < 40; i++) {
+                this.probeA.Poll();
+                Thread.Sleep(25);
+            }
+
+            Console.WriteLine($"[A] link to [B]: {this.probeA.Estimator}, {this.probeA.Estimator.LostCount} probes lost");
             this.systemA.Dispose();
             this.systemB.Dispose();
         }
@@ -1,11 +1,13 @@
 using System;
 using System.Collections.Generic;
-using System.Diagnostics;
 using System.Runtime.CompilerServices;
 using System.Threading.Tasks;
 using REghZyPacketSystem.Packeting.Ack.Attribs;
+using REghZyPacketSystem.Packeting.Flow;
+using REghZyPacketSystem.Packeting.Probe;
 using REghZyPacketSystem.Systems;
 using REghZyPacketSystem.Systems.Handling;
+using REghZyPacketSystem.Utils;
 
 namespace REghZyPacketSystem.Packeting.Ack {
     /// <summary>
@@ -26,6 +28,8 @@ namespace REghZyPacketSystem.Packeting.Ack {
         [ServerSide] private bool allowDuplicateKey;
         [ClientSide] private bool allowResendPacket;
         [ClientSide] private long packetResendTime;
+        [ClientSide] private LinkEstimator linkEstimator;
+        [BothSides] private CreditProcessor creditProcessor;
         [ClientSide] private uint nextId;
         [ClientSide] protected bool isRequestUnderWay;
 
@@ -45,13 +49,44 @@ namespace REghZyPacketSystem.Packeting.Ack {
 
         /// <summary>
         /// The amount of time to wait before sending another packet, only if a responce isn't received within this time period (in milliseconds)
+        /// <para>
+        /// While <see cref="LinkEstimator"/> is set and has measured the link, this is its RTO instead, and setting this has no effect
+        /// </para>
         /// </summary>
         [ClientSide]
         public long PacketResendTime {
-            get => this.packetResendTime;
+            get {
+                LinkEstimator estimator = this.linkEstimator;
+                return estimator != null && estimator.HasSample ? estimator.RtoMillis : this.packetResendTime;
+            }
             set => this.packetResendTime = value;
         }
 
+        /// <summary>
+        /// The link measurements (usually from a <see cref="ProbeProcessor"/> on the same packet system) that
+        /// <see cref="PacketResendTime"/> follows, so resends adapt to the link. Null (the default) uses the fixed resend time
+        /// </summary>
+        [ClientSide]
+        public LinkEstimator LinkEstimator {
+            get => this.linkEstimator;
+            set => this.linkEstimator = value;
+        }
+
+        /// <summary>
+        /// The credit processor (on the same packet system) that requests and responses are sent through, so that they're counted against
+        /// the peer's receive window. Null (the default) sends them with <see cref="PacketSystem.SendPacket"/> directly, which must not be
+        /// used while the packet system has a credit processor
+        /// <para>
+        /// A packet that the credit processor doesn't send straight away is queued, dropped or blocked according to its policy. A dropped request is resent
+        /// if <see cref="AllowResendPacket"/> is set, but a dropped response is lost
+        /// </para>
+        /// </summary>
+        [BothSides]
+        public CreditProcessor CreditProcessor {
+            get => this.creditProcessor;
+            set => this.creditProcessor = value;
+        }
+
         /// <summary>
         /// Whether to process packets that use an idempotency key that has already been processed
         /// <para>
@@ -111,7 +146,7 @@ namespace REghZyPacketSystem.Packeting.Ack {
             packet.key = GetNextKey();
             packet.destination = Destination.ToServer;
             this.sendCache[packet.key] = packet;
-            this.system.SendPacket(packet);
+            SendPacket(packet);
             return packet.key;
         }
 
@@ -133,7 +168,7 @@ namespace REghZyPacketSystem.Packeting.Ack {
             // avoid constant ldfld opcode, just in case it doesn't get optimised
             Dictionary<uint, TPacket> dictionary = this.readCache;
             bool allowResend = this.allowResendPacket;
-            long start = Stopwatch.GetTimestamp() / TimeSpan.TicksPerMillisecond;
+            long start = TimeHelper.MonotonicMicros();
             int count = 0;
 
             while (true) {
@@ -146,8 +181,8 @@ namespace REghZyPacketSystem.Packeting.Ack {
                 if (allowResend) {
                     if (++count > 10) {
                         count = 0;
-                        long current = Stopwatch.GetTimestamp() / TimeSpan.TicksPerMillisecond;
-                        if ((current - start) > this.packetResendTime) {
+                        long current = TimeHelper.MonotonicMicros();
+                        if ((current - start) > (this.PacketResendTime * 1000)) {
                             start = current;
                             if (this.sendCache.TryGetValue(key, out TPacket pkt)) {
                                 HandleResendPacket(pkt);
@@ -196,7 +231,18 @@ namespace REghZyPacketSystem.Packeting.Ack {
         [ServerSide]
         protected void SendToClient(TPacket packet) {
             packet.destination = Destination.ToClient;
-            this.system.SendPacket(packet);
+            SendPacket(packet);
+        }
+
+        [BothSides]
+        private void SendPacket(TPacket packet) {
+            CreditProcessor credits = this.creditProcessor;
+            if (credits != null) {
+                credits.Send(packet);
+            }
+            else {
+                this.system.SendPacket(packet);
+            }
         }
 
         [BothSides]
@@ -245,7 +291,7 @@ namespace REghZyPacketSystem.Packeting.Ack {
         /// </param>
         [ClientSide]
         protected virtual void HandleResendPacket(TPacket packet) {
-            this.system.SendPacket(packet);
+            SendPacket(packet);
             // Console.WriteLine($"Re-transmitting packet '{packet.GetType().Name}'");
         }
 
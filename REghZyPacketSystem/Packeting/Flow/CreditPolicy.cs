@@ -0,0 +1,21 @@
+namespace REghZyPacketSystem.Packeting.Flow {
+    /// <summary>
+    /// What a <see cref="CreditProcessor"/> does when it doesn't have enough credits to send a packet
+    /// </summary>
+    public enum CreditPolicy {
+        /// <summary>
+        /// Wait (up to <see cref="CreditProcessor.BlockTimeout"/>) for the peer to grant more credits
+        /// </summary>
+        Block,
+
+        /// <summary>
+        /// Hold the packet in a bounded queue, and send it as soon as enough credits are granted
+        /// </summary>
+        Queue,
+
+        /// <summary>
+        /// Discard the packet
+        /// </summary>
+        Drop
+    }
+}
@@ -0,0 +1,340 @@
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Threading;
+using REghZyPacketSystem.Systems;
+using REghZyPacketSystem.Systems.Handling;
+
+namespace REghZyPacketSystem.Packeting.Flow {
+    /// <summary>
+    /// Opt-in credit based flow control for a packet system, using the same semantics as the native CreditChannel
+    /// <para>
+    /// Each side grants the other a receive window (in bytes and packets). Every packet sent through <see cref="Send"/>
+    /// costs <see cref="Packet.MinimumHeaderSize"/> plus its payload size in bytes, and 1 frame. Once the credits run out,
+    /// the packet is blocked, queued or dropped, according to <see cref="Policy"/>
+    /// </para>
+    /// <para>
+    /// Received packets are charged as they are read (through <see cref="PacketSystem.ReadFilter"/>), and their credits are
+    /// handed back to the peer as they are delivered by <see cref="PacketSystem.ProcessReadQueue"/>. So the read queue
+    /// can never hold more than the window, and a stalled peer stops the sender instead of causing its buffers to grow forever
+    /// </para>
+    /// <para>
+    /// Received packets that the peer didn't have the credits for are discarded as they are read, before they reach the
+    /// read queue (see <see cref="OverrunCount"/>), like the native CreditChannel does
+    /// </para>
+    /// <para>
+    /// Control packets (IDs from <see cref="FirstControlId"/> up, e.g. credit grants and link probes) are never charged on either side.
+    /// Every other packet must be sent through <see cref="Send"/> (an <see cref="Ack.AckProcessor{TPacket}"/> can be given this processor).
+    /// One sent with <see cref="PacketSystem.SendPacket"/> directly is still charged by the peer, which hands back credits that this side
+    /// never spent, so this side ends up sending more than the peer's window and the peer discards the excess as overruns
+    /// </para>
+    /// <para>
+    /// Both sides must create a processor and call <see cref="Open"/>
+    /// </para>
+    /// </summary>
+    public class CreditProcessor {
+        /// <summary>
+        /// The lowest packet ID reserved for control packets, which are never charged
+        /// </summary>
+        public const ushort FirstControlId = 65531;
+
+        protected readonly PacketSystem system;
+        private readonly object creditLock = new object();
+
+        // sending side
+        private readonly Queue<Packet> queue;
+        private CreditPolicy policy;
+        private int blockTimeout;
+        private uint maxQueuedBytes;
+        private uint queuedBytes;
+        private uint sendBytes;
+        private uint sendFrames;
+        private uint maxSendBytes;
+        private long dropped;
+
+        // receiving side
+        private readonly uint windowBytes;
+        private readonly ushort windowFrames;
+        private uint recvBytes;
+        private uint recvFrames;
+        private uint drainedBytes;
+        private uint drainedFrames;
+        private long overruns;
+
+        /// <summary>
+        /// The packet system that this processor sends packets and credits through
+        /// </summary>
+        public PacketSystem System => this.system;
+
+        /// <summary>
+        /// What to do with a packet when there aren't enough credits to send it
+        /// </summary>
+        public CreditPolicy Policy {
+            get => this.policy;
+            set => this.policy = value;
+        }
+
+        /// <summary>
+        /// The amount of time (in milliseconds) that <see cref="CreditPolicy.Block"/> waits for credits. -1 means wait forever
+        /// </summary>
+        public int BlockTimeout {
+            get => this.blockTimeout;
+            set => this.blockTimeout = value;
+        }
+
+        /// <summary>
+        /// The maximum number of bytes (packet headers included) that <see cref="CreditPolicy.Queue"/> can hold
+        /// </summary>
+        public uint MaxQueuedBytes {
+            get => this.maxQueuedBytes;
+            set => this.maxQueuedBytes = value;
+        }
+
+        /// <summary>
+        /// The number of bytes that can currently be sent without waiting
+        /// </summary>
+        public uint SendBytesCredit {
+            get {
+                lock (this.creditLock) {
+                    return this.sendBytes;
+                }
+            }
+        }
+
+        /// <summary>
+        /// The number of packets that can currently be sent without waiting
+        /// </summary>
+        public uint SendFramesCredit {
+            get {
+                lock (this.creditLock) {
+                    return this.sendFrames;
+                }
+            }
+        }
+
+        /// <summary>
+        /// The number of bytes waiting in the queue
+        /// </summary>
+        public uint QueuedBytes {
+            get {
+                lock (this.creditLock) {
+                    return this.queuedBytes;
+                }
+            }
+        }
+
+        /// <summary>
+        /// The number of packets dropped by <see cref="CreditPolicy.Drop"/>
+        /// </summary>
+        public long DroppedCount => Interlocked.Read(ref this.dropped);
+
+        /// <summary>
+        /// The number of received packets discarded because the peer didn't have the credits to send them
+        /// </summary>
+        public long OverrunCount => Interlocked.Read(ref this.overruns);
+
+        /// <summary>
+        /// Creates a new credit processor
+        /// </summary>
+        /// <param name="system">The packet system to send packets and credits through</param>
+        /// <param name="windowBytes">The number of bytes this side is willing to hold before the application processes them</param>
+        /// <param name="windowFrames">The number of packets this side is willing to hold before the application processes them</param>
+        /// <param name="policy">What to do with packets when there aren't enough credits</param>
+        /// <param name="maxQueuedBytes">The maximum size of the queue used by <see cref="CreditPolicy.Queue"/></param>
+        /// <exception cref="ArgumentNullException">The packet system is null</exception>
+        /// <exception cref="InvalidOperationException">The packet system already has a <see cref="PacketSystem.ReadFilter"/></exception>
+        public CreditProcessor(PacketSystem system, uint windowBytes, ushort windowFrames, CreditPolicy policy = CreditPolicy.Queue, uint maxQueuedBytes = 65536) {
+            if (system == null) {
+                throw new ArgumentNullException(nameof(system), "Network cannot be null");
+            }
+
+            if (windowBytes == 0 || windowFrames == 0) {
+                throw new ArgumentException("The receive window cannot be empty");
+            }
+
+            if (system.ReadFilter != null) {
+                throw new InvalidOperationException("The packet system already has a read filter");
+            }
+
+            this.system = system;
+            this.queue = new Queue<Packet>();
+            this.policy = policy;
+            this.blockTimeout = 1000;
+            this.maxQueuedBytes = maxQueuedBytes;
+            this.windowBytes = windowBytes;
+            this.windowFrames = windowFrames;
+            system.RegisterHandler<PacketCreditGrant>(OnGrantReceived, Priority.HIGHEST);
+            system.ReadFilter = OnPacketRead;
+
+            // listeners of the same priority run before handlers, so every delivered packet hands its credits back
+            system.RegisterListener(OnPacketDelivered, Priority.HIGHEST);
+        }
+
+        /// <summary>
+        /// Grants the peer the entire receive window. This must be called once, before the peer can send anything
+        /// </summary>
+        public void Open() {
+            lock (this.creditLock) {
+                this.recvBytes = this.windowBytes;
+                this.recvFrames = this.windowFrames;
+            }
+
+            this.system.SendPacket(new PacketCreditGrant(this.windowBytes, this.windowFrames));
+        }
+
+        /// <summary>
+        /// Sends the given packet if there are enough credits, otherwise applies the <see cref="Policy"/>
+        /// <para>
+        /// <see cref="CreditPolicy.Block"/> can only be woken up by credit grants, which are delivered by
+        /// <see cref="PacketSystem.ProcessReadQueue"/>. So this must not block the thread that processes the read queue
+        /// </para>
+        /// </summary>
+        /// <param name="packet">The packet to send</param>
+        public CreditSendResult Send(Packet packet) {
+            if (IsControlPacket(packet)) {
+                this.system.SendPacket(packet);
+                return CreditSendResult.Sent;
+            }
+
+            uint cost = GetCost(packet);
+            lock (this.creditLock) {
+                if (this.queue.Count == 0 && CanSpend(cost)) {
+                    Spend(cost);
+                    this.system.SendPacket(packet);
+                    return CreditSendResult.Sent;
+                }
+
+                if (this.maxSendBytes != 0 && cost > this.maxSendBytes) {
+                    return CreditSendResult.TooLarge;
+                }
+
+                switch (this.policy) {
+                    case CreditPolicy.Block:
+                        Stopwatch waited = Stopwatch.StartNew();
+                        while (this.queue.Count != 0 || !CanSpend(cost)) {
+                            int timeout = this.blockTimeout;
+                            if (timeout >= 0) {
+                                timeout -= (int) waited.ElapsedMilliseconds;
+                                if (timeout <= 0 || !Monitor.Wait(this.creditLock, timeout)) {
+                                    return CreditSendResult.TimedOut;
+                                }
+                            }
+                            else {
+                                Monitor.Wait(this.creditLock);
+                            }
+                        }
+
+                        Spend(cost);
+                        this.system.SendPacket(packet);
+                        return CreditSendResult.Sent;
+                    case CreditPolicy.Queue:
+                        if ((this.queuedBytes + cost) > this.maxQueuedBytes) {
+                            return CreditSendResult.QueueFull;
+                        }
+
+                        this.queue.Enqueue(packet);
+                        this.queuedBytes += cost;
+                        return CreditSendResult.Queued;
+                    default:
+                        Interlocked.Increment(ref this.dropped);
+                        return CreditSendResult.Dropped;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Gets the number of credits (in bytes) that sending the given packet costs
+        /// </summary>
+        public static uint GetCost(Packet packet) {
+            return (uint) (Packet.MinimumHeaderSize + packet.GetPayloadSize());
+        }
+
+        /// <summary>
+        /// Whether the given packet is a control packet (its ID is <see cref="FirstControlId"/> or above), which is never charged
+        /// </summary>
+        public static bool IsControlPacket(Packet packet) {
+            return Packet.GetPacketID(packet) >= FirstControlId;
+        }
+
+        private bool CanSpend(uint cost) {
+            return cost <= this.sendBytes && this.sendFrames > 0;
+        }
+
+        private void Spend(uint cost) {
+            this.sendBytes -= cost;
+            this.sendFrames--;
+        }
+
+        private bool OnGrantReceived(PacketCreditGrant grant) {
+            lock (this.creditLock) {
+                this.sendBytes += grant.bytes;
+                this.sendFrames += grant.frames;
+
+                // the first grant is the peer's entire window, so nothing bigger than that can ever be sent
+                if (this.maxSendBytes == 0) {
+                    this.maxSendBytes = grant.bytes;
+                }
+
+                while (this.queue.Count != 0) {
+                    Packet packet = this.queue.Peek();
+                    uint cost = GetCost(packet);
+                    if (!CanSpend(cost)) {
+                        break;
+                    }
+
+                    Spend(cost);
+                    this.queue.Dequeue();
+                    this.queuedBytes -= cost;
+                    this.system.SendPacket(packet);
+                }
+
+                Monitor.PulseAll(this.creditLock);
+            }
+
+            return true;
+        }
+
+        // Returns false (which discards the packet before it is queued) if the peer didn't have the credits to send it
+        private bool OnPacketRead(Packet packet) {
+            if (IsControlPacket(packet)) {
+                return true;
+            }
+
+            uint cost = GetCost(packet);
+            lock (this.creditLock) {
+                if (cost > this.recvBytes || this.recvFrames == 0) {
+                    Interlocked.Increment(ref this.overruns);
+                    return false;
+                }
+
+                this.recvBytes -= cost;
+                this.recvFrames--;
+                return true;
+            }
+        }
+
+        // The packet has left the read queue, so its credits are handed back
+        private void OnPacketDelivered(Packet packet) {
+            if (IsControlPacket(packet)) {
+                return;
+            }
+
+            PacketCreditGrant grant;
+            lock (this.creditLock) {
+                this.drainedBytes += GetCost(packet);
+                this.drainedFrames++;
+                if (this.drainedBytes < (this.windowBytes / 2) && this.drainedFrames < ((this.windowFrames + 1) / 2)) {
+                    return;
+                }
+
+                grant = new PacketCreditGrant(this.drainedBytes, (ushort) this.drainedFrames);
+                this.recvBytes += this.drainedBytes;
+                this.recvFrames += this.drainedFrames;
+                this.drainedBytes = 0;
+                this.drainedFrames = 0;
+            }
+
+            this.system.SendPacket(grant);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+namespace REghZyPacketSystem.Packeting.Flow {
+    /// <summary>
+    /// The outcome of <see cref="CreditProcessor.Send"/>
+    /// </summary>
+    public enum CreditSendResult {
+        /// <summary>
+        /// The packet was given to the packet system to be sent
+        /// </summary>
+        Sent,
+
+        /// <summary>
+        /// The packet was queued, and will be sent once enough credits are granted
+        /// </summary>
+        Queued,
+
+        /// <summary>
+        /// The packet was dropped, because there weren't enough credits
+        /// </summary>
+        Dropped,
+
+        /// <summary>
+        /// No credits were granted within the block timeout; the packet wasn't sent
+        /// </summary>
+        TimedOut,
+
+        /// <summary>
+        /// The queue has no room for the packet; the packet wasn't sent
+        /// </summary>
+        QueueFull,
+
+        /// <summary>
+        /// The packet is bigger than the peer's entire receive window, so it can never be sent
+        /// </summary>
+        TooLarge
+    }
+}
@@ -0,0 +1,59 @@
+using REghZy.Streams;
+
+namespace REghZyPacketSystem.Packeting.Flow {
+    /// <summary>
+    /// Sent by a receiver to give the sender permission to send more data (see <see cref="CreditProcessor"/>).
+    /// The credits are added to whatever the sender already had, they do not replace them
+    /// <para>
+    /// This uses a reserved ID (<see cref="ID"/>), so no other packet may use it
+    /// </para>
+    /// </summary>
+    [PacketImplementation(ID)]
+    public class PacketCreditGrant : Packet {
+        // Credit grant data structure
+        // [ Byte credits ] [ Frame credits ]
+        // [      4b      ] [      2b       ]
+
+        /// <summary>
+        /// The packet ID reserved for credit grants
+        /// </summary>
+        public const ushort ID = 65534;
+
+        /// <summary>
+        /// The number of bytes (packet headers included) that the sender may now send
+        /// </summary>
+        public uint bytes;
+
+        /// <summary>
+        /// The number of packets that the sender may now send
+        /// </summary>
+        public ushort frames;
+
+        public PacketCreditGrant() {
+
+        }
+
+        public PacketCreditGrant(uint bytes, ushort frames) {
+            this.bytes = bytes;
+            this.frames = frames;
+        }
+
+        public override ushort GetPayloadSize() {
+            return 6;
+        }
+
+        public override void ReadPayLoad(IDataInput input, ushort length) {
+            this.bytes = input.ReadUInt();
+            this.frames = input.ReadUShort();
+        }
+
+        public override void WritePayload(IDataOutput output) {
+            output.WriteUInt(this.bytes);
+            output.WriteUShort(this.frames);
+        }
+
+        public override string ToString() {
+            return $"{nameof(PacketCreditGrant)}({this.bytes} bytes, {this.frames} frames)";
+        }
+    }
+}
@@ -0,0 +1,33 @@
+using System;
+using System.Runtime.InteropServices;
+
+namespace REghZyPacketSystem.Packeting.Native {
+    /// <summary>
+    /// The P/Invoke declarations for the native codec bridge (REghZyPacketSystem.Native/bridge/CodecBridge.h)
+    /// </summary>
+    internal static class NativeCodec {
+        /// <summary>
+        /// The name of the shared library built from CodecBridge.cpp (REghZyPacketCodec.dll, or libREghZyPacketCodec.so)
+        /// </summary>
+        public const string LibraryName = "REghZyPacketCodec";
+
+        public const int RZ_CODEC_INVALID_ARG = -1;
+        public const int RZ_CODEC_FRAME_SIZE = -2;
+        public const int RZ_CODEC_BUFFER_FULL = -3;
+
+        [DllImport(LibraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr rz_codec_create(ref NativeCodecConfig config);
+
+        [DllImport(LibraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void rz_codec_destroy(IntPtr codec);
+
+        [DllImport(LibraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern unsafe int rz_codec_decode(IntPtr codec, byte* buffer, uint length, NativeFrame* frames, uint maxFrames, out uint consumed);
+
+        [DllImport(LibraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern unsafe int rz_codec_encode(IntPtr codec, byte* src, NativeFrame* frames, uint count, byte* dst, uint dstLength);
+
+        [DllImport(LibraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern ulong rz_codec_get_skipped(IntPtr codec);
+    }
+}
@@ -0,0 +1,76 @@
+using System.Runtime.InteropServices;
+
+namespace REghZyPacketSystem.Packeting.Native {
+    /// <summary>
+    /// The wire format that a <see cref="NativeFrameCodec"/> decodes and encodes. This has the same layout as the native rz_codec_config
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct NativeCodecConfig {
+        /// <summary>
+        /// The bytes that every frame starts with
+        /// </summary>
+        public byte Preamble1, Preamble2, Preamble3, Preamble4;
+
+        /// <summary>
+        /// How many of the preamble bytes are used (0 - 4)
+        /// <para>
+        /// With no preamble, a corrupted length can't be recovered from, because there's nothing to resync with
+        /// </para>
+        /// </summary>
+        public byte PreambleLength;
+
+        /// <summary>
+        /// The number of bytes in the packet ID; 2 for managed packets, 1 for native packets
+        /// </summary>
+        public byte IdWidth;
+
+        /// <summary>
+        /// Whether the ID and length are little endian (e.g. the connection uses DataOutputStreamLE)
+        /// </summary>
+        public bool LittleEndian {
+            get => this.littleEndian != 0;
+            set => this.littleEndian = (byte) (value ? 1 : 0);
+        }
+
+        private byte littleEndian;
+        private byte reserved;
+
+        /// <summary>
+        /// Frames with a longer payload than this are treated as corrupted
+        /// </summary>
+        public uint MaxPayload;
+
+        /// <summary>
+        /// The format that <see cref="Packet.WritePacket"/> and <see cref="Packet.ReadPacket"/> use, with the current value of <see cref="Packet.UsePreamble"/>
+        /// </summary>
+        /// <param name="littleEndian">Whether the connection's data streams are little endian</param>
+        public static NativeCodecConfig ForManaged(bool littleEndian) {
+            return new NativeCodecConfig() {
+                Preamble1 = Packet.PREAMBLE_SEQ1,
+                Preamble2 = Packet.PREAMBLE_SEQ2,
+                Preamble3 = Packet.PREAMBLE_SEQ3,
+                Preamble4 = Packet.PREAMBLE_SEQ4,
+                PreambleLength = (byte) (Packet.UsePreamble ? 4 : 0),
+                IdWidth = 2,
+                LittleEndian = littleEndian,
+                MaxPayload = (uint) (Packet.MaximumPayloadSize - 1) // ReadPacket rejects lengths >= MaximumPayloadSize
+            };
+        }
+
+        /// <summary>
+        /// The format of the native packet system's Packet.h (the 'rz21' preamble, 1 byte IDs, big endian)
+        /// </summary>
+        public static NativeCodecConfig ForNative() {
+            return new NativeCodecConfig() {
+                Preamble1 = (byte) 'r',
+                Preamble2 = (byte) 'z',
+                Preamble3 = (byte) '2',
+                Preamble4 = (byte) '1',
+                PreambleLength = 4,
+                IdWidth = 1,
+                LittleEndian = false,
+                MaxPayload = 1017
+            };
+        }
+    }
+}
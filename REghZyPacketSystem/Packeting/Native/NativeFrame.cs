@@ -0,0 +1,34 @@
+using System.Runtime.InteropServices;
+
+namespace REghZyPacketSystem.Packeting.Native {
+    /// <summary>
+    /// A single frame found or built by a <see cref="NativeFrameCodec"/>. This has the same layout as the native rz_frame
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct NativeFrame {
+        /// <summary>
+        /// The packet ID
+        /// </summary>
+        public ushort Id;
+
+        private ushort reserved;
+
+        /// <summary>
+        /// Where the payload starts. When decoding, this is relative to the offset the buffer was
+        /// decoded from. When encoding, this is where the payload is in the source buffer
+        /// </summary>
+        public uint Offset;
+
+        /// <summary>
+        /// The number of bytes in the payload
+        /// </summary>
+        public uint Length;
+
+        public NativeFrame(ushort id, uint offset, uint length) {
+            this.Id = id;
+            this.reserved = 0;
+            this.Offset = offset;
+            this.Length = length;
+        }
+    }
+}
@@ -0,0 +1,150 @@
+using System;
+using REghZyPacketSystem.Exceptions;
+
+namespace REghZyPacketSystem.Packeting.Native {
+    /// <summary>
+    /// Finds and builds whole frames using the native codec bridge, so framing costs a single
+    /// native call per batch of frames, rather than managed work for every header byte
+    /// <para>
+    /// This only deals with frame headers; payloads are left where they are. See <see cref="NativeFraming"/>
+    /// for turning the frames into packets
+    /// </para>
+    /// </summary>
+    public sealed class NativeFrameCodec : IDisposable {
+        private IntPtr handle;
+
+        /// <summary>
+        /// The wire format this codec uses
+        /// </summary>
+        public NativeCodecConfig Config { get; }
+
+        /// <summary>
+        /// The total number of bytes that were skipped while looking for a preamble (e.g. because of corruption)
+        /// </summary>
+        public long SkippedBytes => (long) NativeCodec.rz_codec_get_skipped(this.handle);
+
+        /// <summary>
+        /// Creates a codec for the given wire format
+        /// </summary>
+        /// <exception cref="ArgumentException">The config isn't supported</exception>
+        /// <exception cref="DllNotFoundException">The native library couldn't be found</exception>
+        public NativeFrameCodec(NativeCodecConfig config) {
+            this.handle = NativeCodec.rz_codec_create(ref config);
+            if (this.handle == IntPtr.Zero) {
+                throw new ArgumentException("The native codec does not support the given config", nameof(config));
+            }
+
+            this.Config = config;
+        }
+
+        ~NativeFrameCodec() {
+            Dispose();
+        }
+
+        /// <summary>
+        /// Finds as many complete frames as possible (up to the size of the frames array) in the given part of the buffer
+        /// </summary>
+        /// <param name="consumed">
+        /// The number of bytes used up. The bytes after this are the start of a frame that hasn't fully arrived yet,
+        /// so they should be decoded again with the bytes that arrive next
+        /// </param>
+        /// <returns>The number of frames found</returns>
+        /// <exception cref="DataLossException">A frame's length was invalid, and there is no preamble to find the next frame with</exception>
+        public unsafe int Decode(byte[] buffer, int offset, int count, NativeFrame[] frames, out int consumed) {
+            CheckRange(buffer, offset, count);
+            if (frames == null) {
+                throw new ArgumentNullException(nameof(frames));
+            }
+
+            int found;
+            uint used;
+            fixed (byte* ptr = buffer)
+            fixed (NativeFrame* framePtr = frames) {
+                found = NativeCodec.rz_codec_decode(GetHandle(), ptr + offset, (uint) count, framePtr, (uint) frames.Length, out used);
+            }
+
+            if (found == NativeCodec.RZ_CODEC_FRAME_SIZE) {
+                throw new DataLossException("Received a frame with an invalid payload length, and there is no preamble to resync with");
+            }
+            else if (found < 0) {
+                throw new InvalidOperationException("The native codec failed to decode: error " + found);
+            }
+
+            consumed = (int) used;
+            return found;
+        }
+
+        /// <summary>
+        /// Writes a header and payload for the first count frames into the destination buffer, back to back
+        /// </summary>
+        /// <param name="src">The buffer that the frames' payloads are in</param>
+        /// <returns>The number of bytes written</returns>
+        /// <exception cref="ArgumentException">The destination is too small, or a frame's payload is too big</exception>
+        public unsafe int Encode(byte[] src, NativeFrame[] frames, int count, byte[] dst, int dstOffset) {
+            if (src == null || frames == null) {
+                throw new ArgumentNullException(src == null ? nameof(src) : nameof(frames));
+            }
+
+            if (count < 0 || count > frames.Length) {
+                throw new ArgumentOutOfRangeException(nameof(count));
+            }
+
+            CheckRange(dst, dstOffset, dst == null ? 0 : dst.Length - dstOffset);
+            for (int i = 0; i < count; i++) {
+                if ((frames[i].Offset + (ulong) frames[i].Length) > (ulong) src.Length) {
+                    throw new ArgumentException($"Frame {i}'s payload is outside of the source buffer", nameof(frames));
+                }
+            }
+
+            int written;
+            fixed (byte* srcPtr = src)
+            fixed (NativeFrame* framePtr = frames)
+            fixed (byte* dstPtr = dst) {
+                written = NativeCodec.rz_codec_encode(GetHandle(), srcPtr, framePtr, (uint) count, dstPtr + dstOffset, (uint) (dst.Length - dstOffset));
+            }
+
+            switch (written) {
+                case NativeCodec.RZ_CODEC_BUFFER_FULL: throw new ArgumentException("The destination buffer is too small", nameof(dst));
+                case NativeCodec.RZ_CODEC_FRAME_SIZE: throw new ArgumentException($"A payload is bigger than {this.Config.MaxPayload} bytes, or an ID doesn't fit", nameof(frames));
+                default:
+                    if (written < 0) {
+                        throw new InvalidOperationException("The native codec failed to encode: error " + written);
+                    }
+
+                    return written;
+            }
+        }
+
+        /// <summary>
+        /// The number of bytes a frame header takes up in this codec's wire format
+        /// </summary>
+        public int HeaderSize => this.Config.PreambleLength + this.Config.IdWidth + 2;
+
+        public void Dispose() {
+            if (this.handle != IntPtr.Zero) {
+                NativeCodec.rz_codec_destroy(this.handle);
+                this.handle = IntPtr.Zero;
+            }
+
+            GC.SuppressFinalize(this);
+        }
+
+        private IntPtr GetHandle() {
+            if (this.handle == IntPtr.Zero) {
+                throw new ObjectDisposedException(nameof(NativeFrameCodec));
+            }
+
+            return this.handle;
+        }
+
+        private static void CheckRange(byte[] buffer, int offset, int count) {
+            if (buffer == null) {
+                throw new ArgumentNullException(nameof(buffer));
+            }
+
+            if (offset < 0 || count < 0 || (buffer.Length - offset) < count) {
+                throw new ArgumentOutOfRangeException(nameof(offset), "The offset and count are outside of the buffer");
+            }
+        }
+    }
+}
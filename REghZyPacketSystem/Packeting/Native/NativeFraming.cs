@@ -0,0 +1,250 @@
+using System;
+using System.Collections.Generic;
+using System.IO;
+using REghZy.Streams;
+using REghZyPacketSystem.Exceptions;
+using REghZyPacketSystem.Systems;
+
+namespace REghZyPacketSystem.Packeting.Native {
+    /// <summary>
+    /// Offloads a packet system's framing to the native codec bridge. Received bytes are read from the connection
+    /// in large chunks and split into frames with one native call, and queued packets are encoded into one buffer
+    /// with one native call and written with a single stream write. Only the payloads are read and written in managed code
+    /// <para>
+    /// Set this as <see cref="PacketSystem.NativeFraming"/> before anything is read or written, because it reads and writes
+    /// the connection's underlying stream directly, bypassing <see cref="DataStream.Input"/> and <see cref="DataStream.Output"/>.
+    /// Any bytes that <see cref="DataStream.Input"/> has already buffered are skipped, and would corrupt the framing
+    /// </para>
+    /// <para>
+    /// Reading and writing may happen on different threads (e.g. with a <see cref="ThreadPacketSystem"/>),
+    /// but each must only happen on one thread at a time
+    /// </para>
+    /// </summary>
+    public class NativeFraming : IDisposable {
+        private readonly NativeFrameCodec codec;
+
+        // receiving
+        private readonly IDataInput payloadInput;
+        private readonly byte[] receiveBuffer;
+        private readonly NativeFrame[] frames;
+        private int received;
+        private int consumed;
+        private int frameIndex;
+        private int frameCount;
+
+        // sending
+        private readonly IDataOutput payloadOutput;
+        private readonly MemoryStream sendPayloads;
+        private readonly List<Packet> sendBatch;
+        private NativeFrame[] sendFrames;
+        private byte[] sendBuffer;
+
+        /// <summary>
+        /// The codec that finds and builds the frames
+        /// </summary>
+        public NativeFrameCodec Codec => this.codec;
+
+        /// <summary>
+        /// Creates native framing for the managed wire format
+        /// </summary>
+        /// <param name="payloadInput">
+        /// An unbuffered data input with the same endianness as the connection (e.g. a new DataInputStream). Its stream is replaced
+        /// </param>
+        /// <param name="payloadOutput">A data output with the same endianness as the connection. Its stream is replaced</param>
+        /// <param name="littleEndian">Whether the connection's data streams are little endian</param>
+        /// <param name="bufferSize">The size of the receive buffer, which must fit at least one maximum size packet</param>
+        /// <param name="maxFramesPerBatch">The most frames decoded in one native call</param>
+        public NativeFraming(IDataInput payloadInput, IDataOutput payloadOutput, bool littleEndian, int bufferSize = 65536, int maxFramesPerBatch = 256) {
+            if (payloadInput == null || payloadOutput == null) {
+                throw new ArgumentNullException(payloadInput == null ? nameof(payloadInput) : nameof(payloadOutput));
+            }
+
+            if (bufferSize < (Packet.MinimumHeaderSize + Packet.MaximumPayloadSize)) {
+                throw new ArgumentOutOfRangeException(nameof(bufferSize), $"The buffer must be able to hold a maximum size packet ({Packet.MinimumHeaderSize + Packet.MaximumPayloadSize} bytes)");
+            }
+
+            if (maxFramesPerBatch < 1) {
+                throw new ArgumentOutOfRangeException(nameof(maxFramesPerBatch), "There must be at least 1 frame per batch");
+            }
+
+            this.codec = new NativeFrameCodec(NativeCodecConfig.ForManaged(littleEndian));
+            this.receiveBuffer = new byte[bufferSize];
+            this.frames = new NativeFrame[maxFramesPerBatch];
+            this.payloadInput = payloadInput;
+            this.payloadInput.Stream = new MemoryStream(this.receiveBuffer, false);
+            this.sendPayloads = new MemoryStream(4096);
+            this.payloadOutput = payloadOutput;
+            this.payloadOutput.Stream = this.sendPayloads;
+            this.sendBatch = new List<Packet>();
+            this.sendFrames = new NativeFrame[16];
+            this.sendBuffer = new byte[4096];
+        }
+
+        /// <summary>
+        /// Reads up to the given number of packets into the queue. Frames that were already decoded are used first,
+        /// and only once they run out are more bytes read from the connection (only as many as are available, so this doesn't block)
+        /// </summary>
+        /// <param name="filter">Called with each packet before it is queued; packets it returns false for are discarded. May be null</param>
+        /// <returns>The number of packets that were queued</returns>
+        /// <exception cref="PacketCreationException">A frame had an unknown packet ID. The frame is skipped</exception>
+        /// <exception cref="PacketPayloadException">A packet failed to read its payload. The frame is skipped</exception>
+        public int ReadPackets(DataStream stream, Queue<Packet> queue, int count, Predicate<Packet> filter = null) {
+            int read = 0;
+            while (read < count) {
+                if (this.frameIndex == this.frameCount && !ReadFrames(stream)) {
+                    break;
+                }
+
+                NativeFrame frame = this.frames[this.frameIndex++];
+                if (!Packet.TryCreateInstance(frame.Id, out Packet packet)) {
+                    throw new PacketCreationException($"Missing creator for packet ID: {frame.Id}");
+                }
+
+                // the position is set for each packet, so one that reads too little or too much doesn't affect the next
+                this.payloadInput.Stream.Position = frame.Offset;
+                try {
+                    packet.ReadPayLoad(this.payloadInput, (ushort) frame.Length);
+                }
+                catch (Exception e) {
+                    throw new PacketPayloadException($"Failed to read payload from packet type '{packet.GetType().Name}'", e);
+                }
+
+                if (filter != null && !filter(packet)) {
+                    continue;
+                }
+
+                queue.Enqueue(packet);
+                read++;
+            }
+
+            return read;
+        }
+
+        /// <summary>
+        /// Writes up to the given number of packets from the front of the queue to the connection with a single write, and dequeues them
+        /// <para>
+        /// Packets only leave the queue once they're written. If one fails to write, the packets before it are still written,
+        /// it is dequeued and dropped (as <see cref="PacketSystem.ProcessSendQueue"/> does without native framing), and the rest stay queued
+        /// </para>
+        /// </summary>
+        /// <returns>The number of packets written</returns>
+        /// <exception cref="PacketWriteException">
+        /// A packet wasn't registered or failed to write its payload. <see cref="PacketWriteException.Written"/> is the number of packets written before it
+        /// </exception>
+        public int WritePackets(DataStream stream, Queue<Packet> queue, int count) {
+            count = Math.Min(count, queue.Count);
+            this.sendBatch.Clear();
+            foreach (Packet packet in queue) {
+                if (this.sendBatch.Count == count) {
+                    break;
+                }
+
+                this.sendBatch.Add(packet);
+            }
+
+            try {
+                WriteBatch(stream);
+            }
+            catch (PacketWriteException e) {
+                for (int i = 0; i <= e.Written; i++) {
+                    queue.Dequeue();
+                }
+
+                throw;
+            }
+
+            for (int i = 0; i < count; i++) {
+                queue.Dequeue();
+            }
+
+            return count;
+        }
+
+        /// <summary>
+        /// Writes a single packet to the connection
+        /// </summary>
+        public void WritePacket(DataStream stream, Packet packet) {
+            this.sendBatch.Clear();
+            this.sendBatch.Add(packet);
+            WriteBatch(stream);
+        }
+
+        public void Dispose() {
+            this.codec.Dispose();
+        }
+
+        // Moves any partial frame to the start of the buffer, reads whatever is available, and decodes it
+        private bool ReadFrames(DataStream stream) {
+            byte[] buffer = this.receiveBuffer;
+            if (this.consumed != 0) {
+                Buffer.BlockCopy(buffer, this.consumed, buffer, 0, this.received - this.consumed);
+                this.received -= this.consumed;
+                this.consumed = 0;
+            }
+
+            long available = stream.BytesAvailable;
+            int space = buffer.Length - this.received;
+            if (available > 0 && space > 0) {
+                this.received += stream.Stream.Stream.Read(buffer, this.received, (int) Math.Min(available, space));
+            }
+
+            this.frameIndex = 0;
+            this.frameCount = this.codec.Decode(buffer, 0, this.received, this.frames, out this.consumed);
+            return this.frameCount != 0;
+        }
+
+        private void WriteBatch(DataStream stream) {
+            int count = this.sendBatch.Count;
+            if (count == 0) {
+                return;
+            }
+
+            if (this.sendFrames.Length < count) {
+                this.sendFrames = new NativeFrame[Math.Max(count, this.sendFrames.Length * 2)];
+            }
+
+            MemoryStream payloads = this.sendPayloads;
+            payloads.SetLength(0);
+            PacketWriteException failure = null;
+            int encoded = 0;
+            for (; encoded < count; encoded++) {
+                Packet packet = this.sendBatch[encoded];
+                if (!Packet.IsRegistered(packet.GetType())) {
+                    failure = new PacketWriteException($"Packet type '{packet.GetType().Name}' is not registered");
+                    break;
+                }
+
+                long start = payloads.Position;
+                try {
+                    packet.WritePayload(this.payloadOutput);
+                    this.payloadOutput.Flush();
+                }
+                catch (Exception e) {
+                    failure = new PacketWriteException($"Failed to write packet of type '{packet.GetType().Name}'", e);
+                    break;
+                }
+
+                this.sendFrames[encoded] = new NativeFrame(Packet.GetPacketID(packet), (uint) start, (uint) (payloads.Position - start));
+            }
+
+            // the packets before a failed one are still sent; the failed one's partial payload is never referenced by a frame
+            if (encoded != 0) {
+                int required = (int) payloads.Length + encoded * this.codec.HeaderSize;
+                if (this.sendBuffer.Length < required) {
+                    this.sendBuffer = new byte[Math.Max(required, this.sendBuffer.Length * 2)];
+                }
+
+                int written = this.codec.Encode(payloads.GetBuffer(), this.sendFrames, encoded, this.sendBuffer, 0);
+                Stream output = stream.Stream.Stream;
+                output.Write(this.sendBuffer, 0, written);
+                output.Flush();
+            }
+
+            if (failure != null) {
+                failure.WritesAttempted = count;
+                failure.Written = encoded;
+                throw failure;
+            }
+        }
+    }
+}
@@ -35,10 +35,10 @@ namespace REghZyPacketSystem.Packeting {
         // protocol headers
         private static readonly byte[] INIT_PREAMBLE_ARRAY = new byte[32];
         private const byte INIT_PREAMBLE = 0b01010101; // 85, just because it's 1010 etc lol
-        private const byte PREAMBLE_SEQ1 = 0b01110010; // 114 - 'r' - stands for REghZy 2.1 (as in the version of the packet structure :-))
-        private const byte PREAMBLE_SEQ2 = 0b01111010; // 122 - 'z'
-        private const byte PREAMBLE_SEQ3 = 0b00110010; // 50  - '2'
-        private const byte PREAMBLE_SEQ4 = 0b00110010; // 50  - '2'
+        internal const byte PREAMBLE_SEQ1 = 0b01110010; // 114 - 'r' - stands for REghZy 2.1 (as in the version of the packet structure :-))
+        internal const byte PREAMBLE_SEQ2 = 0b01111010; // 122 - 'z'
+        internal const byte PREAMBLE_SEQ3 = 0b00110010; // 50  - '2'
+        internal const byte PREAMBLE_SEQ4 = 0b00110010; // 50  - '2'
 
         /// <summary>
         /// The absolute minimum size of a packet's header. As of REghZyPacketSystem-2.2, this is 4 bytes
@@ -171,6 +171,16 @@ namespace REghZyPacketSystem.Packeting {
             return TypeToId.ContainsKey(type);
         }
 
+        internal static bool TryCreateInstance(ushort id, out Packet packet) {
+            if (IdToCreator.TryGetValue(id, out Func<Packet> creator)) {
+                packet = creator();
+                return true;
+            }
+
+            packet = null;
+            return false;
+        }
+
         /// <summary>
         /// The number of bytes in the packet's payload
         /// </summary>
@@ -0,0 +1,329 @@
+using System;
+
+namespace REghZyPacketSystem.Packeting.Probe {
+    /// <summary>
+    /// Turns probe results into live link estimates, using the same maths as the native LinkEstimator. Every property is safe to read from any thread
+    /// <para>
+    /// The RTT is smoothed the way TCP does it (RFC 6298): <see cref="SmoothedRtt"/> and <see cref="RttVariance"/> are moving averages
+    /// with gains of 1/8 and 1/4, and <see cref="Rto"/> is SRTT + 4 * RTTVAR, clamped to <see cref="MinRto"/> and <see cref="MaxRto"/>.
+    /// A probe that goes unanswered doubles the RTO until the next sample arrives
+    /// </para>
+    /// <para>
+    /// The clock offset is the one measured by the probe with the lowest RTT out of the last few, since that
+    /// probe spent the least time queued, and queueing is rarely symmetric
+    /// </para>
+    /// </summary>
+    public class LinkEstimator {
+        /// <summary>
+        /// The number of samples that the clock offset and peak delivery rate are picked from
+        /// </summary>
+        public const int HistorySize = 8;
+
+        /// <summary>
+        /// The RTO before there are any samples, in microseconds (1 second, as RFC 6298 does)
+        /// </summary>
+        public const long InitialRto = 1000000;
+
+        private readonly object estimateLock = new object();
+        private readonly long[] historyRtt;
+        private readonly long[] historyOffset;
+        private readonly double[] rates;
+        private long minRto;
+        private long maxRto;
+        private long srtt;
+        private long rttVar;
+        private long rto;
+        private long latestRtt;
+        private long minRtt;
+        private long clockOffset;
+        private double deliveryRate;
+        private long samples;
+        private long lost;
+        private long rateSamples;
+
+        /// <summary>
+        /// Whether at least one RTT sample has arrived. Until then, <see cref="Rto"/> is 1 second and everything else is 0
+        /// </summary>
+        public bool HasSample {
+            get {
+                lock (this.estimateLock) {
+                    return this.samples != 0;
+                }
+            }
+        }
+
+        /// <summary>
+        /// The smoothed round trip time, in microseconds
+        /// </summary>
+        public long SmoothedRtt {
+            get {
+                lock (this.estimateLock) {
+                    return this.srtt;
+                }
+            }
+        }
+
+        /// <summary>
+        /// How much the round trip time varies, in microseconds
+        /// </summary>
+        public long RttVariance {
+            get {
+                lock (this.estimateLock) {
+                    return this.rttVar;
+                }
+            }
+        }
+
+        /// <summary>
+        /// How long to wait for a response before resending a request, in microseconds
+        /// </summary>
+        public long Rto {
+            get {
+                lock (this.estimateLock) {
+                    return this.rto;
+                }
+            }
+        }
+
+        /// <summary>
+        /// <see cref="Rto"/>, rounded up to milliseconds (e.g. for <see cref="Ack.AckProcessor{TPacket}.PacketResendTime"/>)
+        /// </summary>
+        public long RtoMillis => (this.Rto + 999) / 1000;
+
+        /// <summary>
+        /// The most recent round trip time, in microseconds
+        /// </summary>
+        public long LatestRtt {
+            get {
+                lock (this.estimateLock) {
+                    return this.latestRtt;
+                }
+            }
+        }
+
+        /// <summary>
+        /// The lowest round trip time seen, in microseconds
+        /// </summary>
+        public long MinRtt {
+            get {
+                lock (this.estimateLock) {
+                    return this.minRtt;
+                }
+            }
+        }
+
+        /// <summary>
+        /// The peer's wall clock minus ours, in microseconds. Add this to a local time to get the peer's time
+        /// </summary>
+        public long ClockOffset {
+            get {
+                lock (this.estimateLock) {
+                    return this.clockOffset;
+                }
+            }
+        }
+
+        /// <summary>
+        /// The smoothed rate the peer has been receiving our bytes at, in bytes per second. This is what the link
+        /// has been carrying, so it only reaches the link's capacity while the link is kept busy
+        /// </summary>
+        public double DeliveryRate {
+            get {
+                lock (this.estimateLock) {
+                    return this.deliveryRate;
+                }
+            }
+        }
+
+        /// <summary>
+        /// The highest delivery rate out of the last few samples, which is the closest estimate of the link's capacity
+        /// </summary>
+        public double PeakDeliveryRate {
+            get {
+                lock (this.estimateLock) {
+                    return PeakRate();
+                }
+            }
+        }
+
+        /// <summary>
+        /// The number of bytes that fit in the link over one round trip (<see cref="PeakDeliveryRate"/> * <see cref="SmoothedRtt"/>), which
+        /// is a sensible size for a batch; anything bigger just queues, and anything smaller leaves the link idle
+        /// </summary>
+        public long BandwidthDelayProduct {
+            get {
+                lock (this.estimateLock) {
+                    return (long) (PeakRate() * this.srtt / 1000000.0);
+                }
+            }
+        }
+
+        /// <summary>
+        /// The number of RTT samples taken
+        /// </summary>
+        public long SampleCount {
+            get {
+                lock (this.estimateLock) {
+                    return this.samples;
+                }
+            }
+        }
+
+        /// <summary>
+        /// The number of probes that were never answered within the RTO
+        /// </summary>
+        public long LostCount {
+            get {
+                lock (this.estimateLock) {
+                    return this.lost;
+                }
+            }
+        }
+
+        /// <summary>
+        /// The lowest the RTO can be, in microseconds. Defaults to 10 milliseconds
+        /// </summary>
+        public long MinRto {
+            get {
+                lock (this.estimateLock) {
+                    return this.minRto;
+                }
+            }
+            set {
+                lock (this.estimateLock) {
+                    this.minRto = value;
+                    this.maxRto = Math.Max(this.maxRto, value);
+                    this.rto = ClampRto(this.rto);
+                }
+            }
+        }
+
+        /// <summary>
+        /// The highest the RTO can be, in microseconds. Defaults to 60 seconds
+        /// </summary>
+        public long MaxRto {
+            get {
+                lock (this.estimateLock) {
+                    return this.maxRto;
+                }
+            }
+            set {
+                lock (this.estimateLock) {
+                    this.maxRto = Math.Max(value, this.minRto);
+                    this.rto = ClampRto(this.rto);
+                }
+            }
+        }
+
+        public LinkEstimator() {
+            this.historyRtt = new long[HistorySize];
+            this.historyOffset = new long[HistorySize];
+            this.rates = new double[HistorySize];
+            this.minRto = 10000;
+            this.maxRto = 60000000;
+            Reset();
+        }
+
+        /// <summary>
+        /// Forgets every sample, e.g. after reconnecting
+        /// </summary>
+        public void Reset() {
+            lock (this.estimateLock) {
+                this.srtt = 0;
+                this.rttVar = 0;
+                this.rto = ClampRto(InitialRto);
+                this.latestRtt = 0;
+                this.minRtt = 0;
+                this.clockOffset = 0;
+                this.deliveryRate = 0;
+                this.samples = 0;
+                this.lost = 0;
+                this.rateSamples = 0;
+                for (int i = 0; i < HistorySize; i++) {
+                    this.historyRtt[i] = -1;
+                    this.historyOffset[i] = 0;
+                    this.rates[i] = 0;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Adds a round trip (with the peer's processing time already taken out) and the clock offset it measured, both in microseconds
+        /// </summary>
+        public void OnSample(long rtt, long offset) {
+            lock (this.estimateLock) {
+                if (this.samples == 0) {
+                    this.srtt = rtt;
+                    this.rttVar = rtt / 2;
+                    this.minRtt = rtt;
+                }
+                else {
+                    this.rttVar = (3 * this.rttVar + Math.Abs(this.srtt - rtt)) / 4;
+                    this.srtt = (7 * this.srtt + rtt) / 8;
+                    this.minRtt = Math.Min(this.minRtt, rtt);
+                }
+
+                this.latestRtt = rtt;
+                this.rto = ClampRto(this.srtt + Math.Max(this.rttVar * 4, 1));
+
+                int slot = (int) (this.samples % HistorySize);
+                this.historyRtt[slot] = rtt;
+                this.historyOffset[slot] = offset;
+                this.samples++;
+                int best = 0;
+                for (int i = 1; i < HistorySize; i++) {
+                    if (this.historyRtt[i] >= 0 && (this.historyRtt[best] < 0 || this.historyRtt[i] < this.historyRtt[best])) {
+                        best = i;
+                    }
+                }
+
+                this.clockOffset = this.historyOffset[best];
+            }
+        }
+
+        /// <summary>
+        /// Adds a delivery rate measurement: the peer received the given number of bytes over the given number of microseconds
+        /// </summary>
+        public void OnDelivered(ulong bytes, long micros) {
+            if (micros <= 0) {
+                return;
+            }
+
+            double rate = bytes * 1000000.0 / micros;
+            lock (this.estimateLock) {
+                this.deliveryRate = this.rateSamples == 0 ? rate : this.deliveryRate + (rate - this.deliveryRate) / 4;
+                this.rates[this.rateSamples % HistorySize] = rate;
+                this.rateSamples++;
+            }
+        }
+
+        /// <summary>
+        /// A probe wasn't answered within the RTO, so back off (RFC 6298, 5.5)
+        /// </summary>
+        public void OnTimeout() {
+            lock (this.estimateLock) {
+                this.lost++;
+                this.rto = ClampRto(this.rto * 2);
+            }
+        }
+
+        public override string ToString() {
+            lock (this.estimateLock) {
+                return $"{nameof(LinkEstimator)}(srtt {this.srtt}us, rttvar {this.rttVar}us, rto {this.rto}us, offset {this.clockOffset}us, rate {this.deliveryRate:F0}B/s)";
+            }
+        }
+
+        private long ClampRto(long value) {
+            return Math.Min(Math.Max(value, this.minRto), this.maxRto);
+        }
+
+        private double PeakRate() {
+            double peak = 0;
+            foreach (double rate in this.rates) {
+                peak = Math.Max(peak, rate);
+            }
+
+            return peak;
+        }
+    }
+}
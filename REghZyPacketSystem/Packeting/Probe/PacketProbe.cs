@@ -0,0 +1,58 @@
+using REghZy.Streams;
+
+namespace REghZyPacketSystem.Packeting.Probe {
+    /// <summary>
+    /// Sent to measure the link (see <see cref="ProbeProcessor"/>). The peer answers every probe with a <see cref="PacketProbeReply"/>, straight away
+    /// <para>
+    /// This uses a reserved ID (<see cref="ID"/>), so no other packet may use it
+    /// </para>
+    /// </summary>
+    [PacketImplementation(ID)]
+    public class PacketProbe : Packet {
+        // Probe data structure
+        // [ Sequence ] [ Origin time ]
+        // [    4b    ] [     8b      ]
+
+        /// <summary>
+        /// The packet ID reserved for probes
+        /// </summary>
+        public const ushort ID = 65532;
+
+        /// <summary>
+        /// Identifies the probe, so that its reply can be matched up with it
+        /// </summary>
+        public uint seq;
+
+        /// <summary>
+        /// The sender's wall clock when the probe was sent, in microseconds since the unix epoch
+        /// </summary>
+        public long origin;
+
+        public PacketProbe() {
+
+        }
+
+        public PacketProbe(uint seq, long origin) {
+            this.seq = seq;
+            this.origin = origin;
+        }
+
+        public override ushort GetPayloadSize() {
+            return 12;
+        }
+
+        public override void ReadPayLoad(IDataInput input, ushort length) {
+            this.seq = input.ReadUInt();
+            this.origin = input.ReadLong();
+        }
+
+        public override void WritePayload(IDataOutput output) {
+            output.WriteUInt(this.seq);
+            output.WriteLong(this.origin);
+        }
+
+        public override string ToString() {
+            return $"{nameof(PacketProbe)}(#{this.seq})";
+        }
+    }
+}
@@ -0,0 +1,82 @@
+using REghZy.Streams;
+
+namespace REghZyPacketSystem.Packeting.Probe {
+    /// <summary>
+    /// The answer to a <see cref="PacketProbe"/>. The times are microseconds since the unix epoch, on the replying side's wall clock
+    /// <para>
+    /// This uses a reserved ID (<see cref="ID"/>), so no other packet may use it
+    /// </para>
+    /// </summary>
+    [PacketImplementation(ID)]
+    public class PacketProbeReply : Packet {
+        // Probe reply data structure
+        // [ Sequence ] [ Origin time ] [ Receive time ] [ Transmit time ] [ Bytes received ]
+        // [    4b    ] [     8b      ] [      8b      ] [       8b      ] [       8b       ]
+
+        /// <summary>
+        /// The packet ID reserved for probe replies
+        /// </summary>
+        public const ushort ID = 65531;
+
+        /// <summary>
+        /// The sequence number of the probe being answered
+        /// </summary>
+        public uint seq;
+
+        /// <summary>
+        /// The probe's origin time, echoed back
+        /// </summary>
+        public long origin;
+
+        /// <summary>
+        /// When the probe was received
+        /// </summary>
+        public long receive;
+
+        /// <summary>
+        /// When this reply was sent
+        /// </summary>
+        public long transmit;
+
+        /// <summary>
+        /// The total number of bytes (packet headers included) the replying side had received when the probe arrived
+        /// </summary>
+        public ulong received;
+
+        public PacketProbeReply() {
+
+        }
+
+        public PacketProbeReply(uint seq, long origin, long receive, long transmit, ulong received) {
+            this.seq = seq;
+            this.origin = origin;
+            this.receive = receive;
+            this.transmit = transmit;
+            this.received = received;
+        }
+
+        public override ushort GetPayloadSize() {
+            return 36;
+        }
+
+        public override void ReadPayLoad(IDataInput input, ushort length) {
+            this.seq = input.ReadUInt();
+            this.origin = input.ReadLong();
+            this.receive = input.ReadLong();
+            this.transmit = input.ReadLong();
+            this.received = input.ReadULong();
+        }
+
+        public override void WritePayload(IDataOutput output) {
+            output.WriteUInt(this.seq);
+            output.WriteLong(this.origin);
+            output.WriteLong(this.receive);
+            output.WriteLong(this.transmit);
+            output.WriteULong(this.received);
+        }
+
+        public override string ToString() {
+            return $"{nameof(PacketProbeReply)}(#{this.seq}, {this.transmit - this.receive}us held)";
+        }
+    }
+}
@@ -0,0 +1,177 @@
+using System;
+using System.Threading;
+using REghZyPacketSystem.Systems;
+using REghZyPacketSystem.Systems.Handling;
+using REghZyPacketSystem.Utils;
+
+namespace REghZyPacketSystem.Packeting.Probe {
+    /// <summary>
+    /// Measures the link that a packet system is connected over, using the same probes as the native LinkProbe
+    /// <para>
+    /// Every <see cref="Interval"/>, <see cref="Poll"/> sends a <see cref="PacketProbe"/>, which the peer answers with a
+    /// <see cref="PacketProbeReply"/>. The replies feed the <see cref="Estimator"/>: the round trip time (and an RTO derived from it,
+    /// like TCP's), the rate that the peer receives our bytes at, and the offset between the two wall clocks
+    /// </para>
+    /// <para>
+    /// Replies are sent and handled through <see cref="PacketSystem.ProcessReadQueue"/> and <see cref="PacketSystem.ProcessSendQueue"/>,
+    /// so the RTT includes the time packets wait in those queues, which is the latency the application actually sees
+    /// </para>
+    /// <para>
+    /// Both sides must create a processor (or at least answer probes). Pass the <see cref="Estimator"/> to an
+    /// <see cref="Ack.AckProcessor{TPacket}"/> to have its resend time follow the link
+    /// </para>
+    /// </summary>
+    public class ProbeProcessor {
+        /// <summary>
+        /// The number of probes that can be waiting for a reply
+        /// </summary>
+        public const int MaxOutstanding = 16;
+
+        protected readonly PacketSystem system;
+        private readonly LinkEstimator estimator;
+        private readonly object probeLock = new object();
+        private readonly uint[] outstandingSeq;
+        private readonly long[] outstandingSent;
+        private int interval;
+        private uint nextSeq;
+        private long lastProbe;
+        private long bytesReceived;
+
+        // only touched by the reply handler
+        private bool hasLastReply;
+        private long lastReceive;
+        private ulong lastReceived;
+
+        /// <summary>
+        /// The packet system that this processor sends probes through
+        /// </summary>
+        public PacketSystem System => this.system;
+
+        /// <summary>
+        /// The live link estimates
+        /// </summary>
+        public LinkEstimator Estimator => this.estimator;
+
+        /// <summary>
+        /// How often <see cref="Poll"/> sends a probe, in milliseconds
+        /// </summary>
+        public int Interval {
+            get => this.interval;
+            set => this.interval = value;
+        }
+
+        /// <summary>
+        /// The number of bytes (packet headers included) delivered by the packet system, probes and replies included
+        /// </summary>
+        public long BytesReceived => Interlocked.Read(ref this.bytesReceived);
+
+        /// <summary>
+        /// Creates a new probe processor
+        /// </summary>
+        /// <param name="system">The packet system to send probes through</param>
+        /// <param name="interval">How often <see cref="Poll"/> sends a probe, in milliseconds</param>
+        /// <exception cref="ArgumentNullException">The packet system is null</exception>
+        public ProbeProcessor(PacketSystem system, int interval = 1000) {
+            if (system == null) {
+                throw new ArgumentNullException(nameof(system), "Network cannot be null");
+            }
+
+            this.system = system;
+            this.estimator = new LinkEstimator();
+            this.outstandingSeq = new uint[MaxOutstanding];
+            this.outstandingSent = new long[MaxOutstanding];
+            this.interval = interval;
+
+            // listeners of the same priority run before handlers, so a probe counts itself in the bytes received
+            system.RegisterListener(OnPacketDelivered, Priority.HIGHEST);
+            system.RegisterHandler<PacketProbe>(OnProbeReceived, Priority.HIGHEST);
+            system.RegisterHandler<PacketProbeReply>(OnReplyReceived, Priority.HIGHEST);
+        }
+
+        /// <summary>
+        /// Sends a probe now, regardless of the <see cref="Interval"/>
+        /// </summary>
+        public void Probe() {
+            uint seq;
+            lock (this.probeLock) {
+                seq = this.nextSeq++;
+                this.lastProbe = TimeHelper.MonotonicMicros();
+                int slot = (int) (seq % MaxOutstanding);
+                if (this.outstandingSent[slot] != 0) {
+                    this.estimator.OnTimeout(); // so many probes went unanswered that this one's slot is being reused
+                }
+
+                this.outstandingSeq[slot] = seq;
+                this.outstandingSent[slot] = this.lastProbe;
+            }
+
+            this.system.SendPacket(new PacketProbe(seq, TimeHelper.UnixMicros()));
+        }
+
+        /// <summary>
+        /// Counts probes that weren't answered within the RTO as lost, and sends a probe if the <see cref="Interval"/> has passed.
+        /// This should be called regularly, e.g. alongside <see cref="PacketSystem.ProcessSendQueue"/>
+        /// </summary>
+        public void Poll() {
+            long now = TimeHelper.MonotonicMicros();
+            long rto = this.estimator.Rto;
+            bool due;
+            lock (this.probeLock) {
+                for (int i = 0; i < MaxOutstanding; i++) {
+                    if (this.outstandingSent[i] != 0 && (now - this.outstandingSent[i]) > rto) {
+                        this.outstandingSent[i] = 0;
+                        this.estimator.OnTimeout();
+                    }
+                }
+
+                due = this.lastProbe == 0 || (now - this.lastProbe) >= this.interval * 1000L;
+            }
+
+            if (due) {
+                Probe();
+            }
+        }
+
+        private void OnPacketDelivered(Packet packet) {
+            Interlocked.Add(ref this.bytesReceived, Packet.MinimumHeaderSize + packet.GetPayloadSize());
+        }
+
+        private bool OnProbeReceived(PacketProbe probe) {
+            long receive = TimeHelper.UnixMicros();
+            ulong received = (ulong) Interlocked.Read(ref this.bytesReceived);
+            this.system.SendPacket(new PacketProbeReply(probe.seq, probe.origin, receive, TimeHelper.UnixMicros(), received));
+            return true;
+        }
+
+        private bool OnReplyReceived(PacketProbeReply reply) {
+            long now = TimeHelper.MonotonicMicros();
+            long wallNow = TimeHelper.UnixMicros();
+            long sent;
+            lock (this.probeLock) {
+                int slot = (int) (reply.seq % MaxOutstanding);
+                if (this.outstandingSent[slot] == 0 || this.outstandingSeq[slot] != reply.seq) {
+                    return true; // a late reply to a probe that was already counted as lost
+                }
+
+                sent = this.outstandingSent[slot];
+                this.outstandingSent[slot] = 0;
+            }
+
+            // the RTT uses the monotonic clock, so a wall clock step can't ruin it. Only the offset uses the wall clocks
+            long held = Math.Max(reply.transmit - reply.receive, 0);
+            long rtt = Math.Max((now - sent) - held, 0);
+            long offset = ((reply.receive - reply.origin) + (reply.transmit - wallNow)) / 2;
+            this.estimator.OnSample(rtt, offset);
+
+            // both ends of the delivery rate come from the peer's clock
+            if (this.hasLastReply && reply.received > this.lastReceived) {
+                this.estimator.OnDelivered(reply.received - this.lastReceived, reply.receive - this.lastReceive);
+            }
+
+            this.lastReceive = reply.receive;
+            this.lastReceived = reply.received;
+            this.hasLastReply = true;
+            return true;
+        }
+    }
+}
@@ -4,6 +4,7 @@ using System.Threading;
 using REghZy.Streams;
 using REghZyPacketSystem.Exceptions;
 using REghZyPacketSystem.Packeting;
+using REghZyPacketSystem.Packeting.Native;
 using REghZyPacketSystem.Systems.Handling;
 
 namespace REghZyPacketSystem.Systems {
@@ -29,6 +30,9 @@ namespace REghZyPacketSystem.Systems {
         /// </summary>
         protected readonly Queue<Packet> sendQueue;
 
+        private NativeFraming nativeFraming;
+        private Predicate<Packet> readFilter;
+
         /// <summary>
         /// The packets that have been read/received from the connection, and are ready to be processed
         /// </summary>
@@ -55,6 +59,30 @@ namespace REghZyPacketSystem.Systems {
         /// </summary>
         public bool IsConnected => this.connection.IsConnected;
 
+        /// <summary>
+        /// When set, framing is done by the native codec bridge instead of <see cref="Packet.ReadPacket"/> and <see cref="Packet.WritePacket"/>,
+        /// so packets are read and written in batches, with one native call per batch. This is null by default
+        /// <para>
+        /// This must be set before anything is read or written, and must not be changed afterwards
+        /// </para>
+        /// </summary>
+        public NativeFraming NativeFraming {
+            get => this.nativeFraming;
+            set => this.nativeFraming = value;
+        }
+
+        /// <summary>
+        /// When set, this is called with every packet as soon as it is read, and packets it returns false for are discarded
+        /// instead of being queued in <see cref="ReadQueue"/> (e.g. by a <see cref="Packeting.Flow.CreditProcessor"/>). This is null by default
+        /// <para>
+        /// This is called on whichever thread reads packets, while <see cref="ReadQueue"/> is locked
+        /// </para>
+        /// </summary>
+        public Predicate<Packet> ReadFilter {
+            get => this.readFilter;
+            set => this.readFilter = value;
+        }
+
         /// <summary>
         /// Creates a new instance of a packet system, using the given connection
         /// </summary>
@@ -223,13 +251,20 @@ namespace REghZyPacketSystem.Systems {
         /// Reads the next available packet, and enqueues it in <see cref="ReadQueue"/>
         /// </summary>
         /// <returns>
-        /// True if a packet was read, otherwise false (if there wasn't enough data available to read a packet header)
+        /// True if a packet was read, otherwise false (if there wasn't enough data available to read a packet header).
+        /// A packet that <see cref="ReadFilter"/> discards still counts as read
         /// </returns>
         public bool ReadNextPacket() {
             if (this.connection == null) {
                 throw new NullReferenceException("Connection is unavailable");
             }
 
+            if (this.nativeFraming != null) {
+                lock (this.readQueue) {
+                    return ReadNativePackets(1) != 0;
+                }
+            }
+
             long available = this.connection.Stream.BytesAvailable;
             if (available < Packet.MinimumHeaderSize)
                 return false;
@@ -241,7 +276,8 @@ namespace REghZyPacketSystem.Systems {
             return true;
         }
 
-        internal void ReadNextPacketInternal(IDataInput input) {
+        // Returns whether the packet was queued (rather than discarded by the read filter)
+        internal bool ReadNextPacketInternal(IDataInput input) {
             Packet packet;
             try {
                 packet = Packet.ReadPacket(input);
@@ -250,7 +286,21 @@ namespace REghZyPacketSystem.Systems {
                 throw new PacketCreationException("Failed to read next packet", e);
             }
 
+            if (this.readFilter != null && !this.readFilter(packet)) {
+                return false;
+            }
+
             this.readQueue.Enqueue(packet);
+            return true;
+        }
+
+        private int ReadNativePackets(int count) {
+            try {
+                return this.nativeFraming.ReadPackets(this.connection.Stream, this.readQueue, count, this.readFilter);
+            }
+            catch (Exception e) {
+                throw new PacketCreationException("Failed to read next packet", e);
+            }
         }
 
         /// <summary>
@@ -266,10 +316,13 @@ namespace REghZyPacketSystem.Systems {
 
             int read = 0;
             lock (this.readQueue) {
+                if (this.nativeFraming != null) {
+                    return ReadNativePackets(count);
+                }
+
                 IDataInput input = this.connection.Stream.Input;
                 while (this.connection.Stream.BytesAvailable >= Packet.MinimumHeaderSize) {
-                    ReadNextPacketInternal(input);
-                    if ((++read) == count) {
+                    if (ReadNextPacketInternal(input) && (++read) == count) {
                         return read;
                     }
                 }
@@ -338,6 +391,21 @@ namespace REghZyPacketSystem.Systems {
                     return 0;
                 }
 
+                if (this.nativeFraming != null) {
+                    try {
+                        return this.nativeFraming.WritePackets(this.connection.Stream, queue, count);
+                    }
+                    catch (PacketWriteException) {
+                        throw; // already says how many packets were written
+                    }
+                    catch (Exception e) {
+                        throw new PacketWriteException("Failed to write a batch of packets", e) {
+                            WritesAttempted = count,
+                            Written = 0
+                        };
+                    }
+                }
+
                 int sent = 0;
                 IDataOutput output = this.connection.Stream.Output;
                 while (sent != count) {
@@ -377,6 +445,14 @@ namespace REghZyPacketSystem.Systems {
         /// </summary>
         /// <param name="packet">The packet to send (non-null)</param>
         public void SendPacketImmidiately(Packet packet) {
+            if (this.nativeFraming != null) {
+                lock (this.sendQueue) {
+                    this.nativeFraming.WritePacket(this.connection.Stream, packet);
+                }
+
+                return;
+            }
+
             Packet.WritePacket(packet, this.connection.Stream.Output);
         }
     }
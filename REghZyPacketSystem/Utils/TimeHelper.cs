@@ -7,5 +7,23 @@ namespace REghZyPacketSystem.Utils {
             // return DateTimeOffset.UtcNow.ToUnixTimeMilliseconds();
             return Stopwatch.GetTimestamp() / TimeSpan.TicksPerMillisecond;
         }
+
+        private static readonly double MicrosPerTimestamp = 1000000.0 / Stopwatch.Frequency;
+        private static readonly long UnixEpochTicks = new DateTime(1970, 1, 1, 0, 0, 0, DateTimeKind.Utc).Ticks;
+
+        /// <summary>
+        /// A monotonic time in microseconds, which is only useful for measuring intervals. Unlike the wall clock,
+        /// this never jumps when the system time is changed
+        /// </summary>
+        public static long MonotonicMicros() {
+            return (long) (Stopwatch.GetTimestamp() * MicrosPerTimestamp);
+        }
+
+        /// <summary>
+        /// The wall clock, in microseconds since the unix epoch. This is the clock that link probes compare between peers
+        /// </summary>
+        public static long UnixMicros() {
+            return (DateTime.UtcNow.Ticks - UnixEpochTicks) / 10;
+        }
     }
 }